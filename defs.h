@@ -9,6 +9,11 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct swapparams;
+struct vmstat;
+struct loadstat;
+struct pmemstat;
+struct memlimit;
 
 // bio.c
 void            binit(void);
@@ -41,6 +46,7 @@ struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
+uint            ibmap(struct inode*, uint);
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
@@ -52,14 +58,15 @@ struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
-void            swapread(uint, void*);
-void            swapwrite(uint, void*);
 void            printpage(void);
 
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            iderwpage(uint, uint, char*, int);
+void            iderwpages(uint, uint, char**, int, int);
+int             idepresent(uint);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -71,6 +78,11 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+int             kfreepage(void);
+int             kref(char*);
+int             kunref(char*);
+int             krefcount(char*);
+void            kmemstat(int*, int*, int*);
 
 // kbd.c
 void            kbdintr(void);
@@ -82,6 +94,7 @@ extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
+void            lapicipi(uchar, int);
 void            microdelay(int);
 
 // log.c
@@ -111,15 +124,27 @@ void            exit(void);
 int             fork(void);
 int             growproc(int);
 int             kill(int);
+void            loadctl(void);
+void            loadstat(struct loadstat*);
+void            loadwait(void);
+int             memlimit(int, struct memlimit*, int);
+int             oomkill(void);
+void            pfftick(void);
+int             pmemstat(int, struct pmemstat*);
+struct proc*    kthread(char*, void(*)(void));
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+void            procfltstat(int, int, int*, uint*, uint*, int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+int             vmhold(struct proc*);
+void            vmput(struct proc*);
+void            vmquiesce(struct proc*);
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
@@ -163,6 +188,7 @@ void            syscall(void);
 void            timerinit(void);
 
 // trap.c
+void            fltstat(int, uint*, int);
 void            idtinit(void);
 extern uint     ticks;
 void            tvinit(void);
@@ -184,6 +210,9 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             cowcopy(pde_t*, uint);
+void            tlbflush(pde_t*, uint*, int);
+void            tlbflushintr(void);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
@@ -193,22 +222,60 @@ typedef uint pte_t;
 typedef uint pde_t;
 
 void            swapInit(void);
+int             swapadddev(int, uint, uint*, int, int);
+int             swapfile(struct inode*, int);
+void            swapdevinit(void);
 int             swappage_in(pde_t *pgdir, void *va);
-void            checkAswap(void);
+int             faultin(uint, uint, int);
+int             faultretry(uint, int);
+void            swapinproc(void);
+void            rsstrim(void);
+int             framelocked(uint);
+int             lockedpages(pde_t*, uint);
+int             mlock(uint, uint);
+int             munlock(uint, uint);
+int             madvise(uint, uint, int);
+void            kprefetch(void);
+void            prefetchcancel(struct proc*);
+int             checkAswap(void);
+int             directreclaim(void);
+void            kswapd(void);
+void            kswapdwakeup(int);
 void            swapFree(struct proc*);
+void            swapdrop(pte_t);
+void            swapwait(pte_t*);
+void            swaprelax(void);
+int             swapctl(struct swapparams*, int);
+void            getvmstat(struct vmstat*);
+extern struct vmstat vmstat;
 int             countpages(void);
 int             findslot(void);
+int             findslotnear(int);
 void            freeslot(int);
+int             slotinuse(int);
+void            frameadd(uint, uint);
+void            framedel(uint, int);
+int             swapfreeslots(void);
 int             swappageout(pde_t*, uint, uint);
 struct proc*    findproc(void);
 uint            findpage(pde_t*, uint*);
-void            swapout(void);
+int             swapout(void);
 int             duplicateslot(int);
 
+// zswap.c
+struct zswapstat;
+void            zswapinit(void);
+int             zstore(char*);
+int             zload(int, char*);
+void            zdup(int);
+void            zfree(int);
+void            zswapstat(struct zswapstat*);
+
 pte_t*          walkpgdir(pde_t*, const void*, int);
+pte_t*          nextpte(pde_t*, uint*, uint);
+int             residentpages(pde_t*, uint);
+int             swappedpages(pde_t*, uint);
 int             mappages(pde_t*, void*, uint, uint, int);
 
-int             kfreepage(void);
-
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
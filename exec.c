@@ -94,14 +94,19 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
+  prefetchcancel(curproc);
+  vmquiesce(curproc);
   oldpgdir = curproc->pgdir;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
-  curproc->rss = curproc->sz / PGSIZE;
+  curproc->rss = residentpages(pgdir, sz);
+  curproc->mlocked = 0;
+  memset(curproc->advice, 0, sizeof(curproc->advice));
   switchuvm(curproc);
   freevm(oldpgdir);
+  curproc->vmfrozen = 0;
   return 0;
 
  bad:
@@ -0,0 +1,45 @@
+// Print page fault latency histograms and per-process fault counts.
+//   fltstat [-r]
+// With -r the statistics are cleared after being printed.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "fltstat.h"
+
+static char *kinds[NFLTKIND] = {
+[FLT_MINOR]  "minor",
+[FLT_MAJOR]  "major",
+[FLT_FAILED] "failed",
+};
+
+struct fltstat st;
+
+int
+main(int argc, char *argv[])
+{
+  int k, b, i, reset;
+
+  reset = argc > 1 && strcmp(argv[1], "-r") == 0;
+  if(argc > 2 || (argc == 2 && !reset)){
+    printf(2, "usage: fltstat [-r]\n");
+    exit();
+  }
+  if(fltstat(&st, reset) < 0){
+    printf(2, "fltstat: failed\n");
+    exit();
+  }
+
+  for(k = 0; k < NFLTKIND; k++){
+    printf(1, "%s faults, cycles: count\n", kinds[k]);
+    for(b = 0; b < NFLTBUCKET; b++)
+      if(st.hist[k][b])
+        printf(1, "  2^%d: %d\n", b, st.hist[k][b]);
+  }
+  printf(1, "pid majflt minflt\n");
+  for(i = 0; i < NPROC; i++)
+    if(st.pid[i] > 0)
+      printf(1, "%d %d %d\n", st.pid[i], st.majflt[i], st.minflt[i]);
+  exit();
+}
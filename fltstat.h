@@ -0,0 +1,16 @@
+// Page fault statistics returned by fltstat(). Needs param.h.
+#define NFLTBUCKET 32   // Latency buckets: bucket i counts faults
+                        // that took 2^i to 2^(i+1)-1 cycles
+
+// Kinds of page fault
+#define FLT_MINOR  0    // Resolved without disk I/O
+#define FLT_MAJOR  1    // Read the page from the swap disk
+#define FLT_FAILED 2    // Not resolved; the process is killed
+#define NFLTKIND   3
+
+struct fltstat {
+  uint hist[NFLTKIND][NFLTBUCKET];  // Fault latency histograms
+  int pid[NPROC];                   // Process in each slot, or 0
+  uint majflt[NPROC];               // Its major faults
+  uint minflt[NPROC];               // Its minor faults
+};
@@ -266,6 +266,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->swap = 0;
   release(&icache.lock);
 
   return ip;
@@ -399,6 +400,17 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Return the disk block address of the nth block of data in the
+// locked inode ip, or 0 if that is past the end of the file.
+// Unlike bmap, never allocates.
+uint
+ibmap(struct inode *ip, uint bn)
+{
+  if(bn >= (ip->size + BSIZE - 1) / BSIZE)
+    return 0;
+  return bmap(ip, bn);
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
@@ -411,6 +423,9 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  if(ip->swap)
+    panic("itrunc: swap file");
+
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -490,6 +505,9 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return devsw[ip->major].write(ip, src, n);
   }
 
+  // Swap I/O goes to the file's blocks behind the log's back.
+  if(ip->swap)
+    return -1;
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
@@ -668,23 +686,3 @@ nameiparent(char *path, char *name)
 {
   return namex(path, 1, name);
 }
-
-
-void swapread(uint block, void* buf){
-    struct buf* b;
-    
-    b = bread(0,block);
-    memmove(buf, b->data, BSIZE);
-    brelse(b);
-}
-
-void swapwrite(uint block, void *buf){
-    struct buf* b;
-    b = bread(0,block);
-    memmove(buf, b->data, BSIZE);
-
-    b->flags |= B_DIRTY;
-    bwrite(b);
-
-    brelse(b);
-}
\ No newline at end of file
@@ -23,6 +23,9 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMUL 0xc6
+
+#define PGSECTS       (PGSIZE/SECTOR_SIZE)
 
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
@@ -31,8 +34,31 @@
 static struct spinlock idelock;
 static struct buf *idequeue;
 
+// Swap pages move between the disk and physical pages in one
+// multi-sector command, bypassing the buffer cache. A request
+// covers a run of consecutive on-disk pages; with the multiple
+// count set to one page, the disk interrupts once per page.
+// Swap requests wait on their own queue; the disk alternates
+// between the two queues. swapactive is the swap request on the
+// disk, if any. While it is set, the head of idequeue has not been
+// started yet.
+struct swapreq {
+  uint dev;
+  uint sector;            // first sector of the run
+  char **addr;            // kernel address of each page
+  int n;                  // pages in the run
+  int cur;                // pages transferred so far
+  int write;
+  int done;
+  struct swapreq *qnext;
+};
+
+static struct swapreq *swapqueue;
+static struct swapreq *swapactive;
+
 static int havedisk1;
 static void idestart(struct buf*);
+static void swapstart(void);
 
 // Wait for IDE disk to become ready.
 static int
@@ -65,8 +91,18 @@ ideinit(void)
     }
   }
 
+  // Let READ/WRITE MULTIPLE move a whole page per interrupt.
+  if(havedisk1){
+    outb(0x1f2, PGSECTS);
+    outb(0x1f7, IDE_CMD_SETMUL);
+    idewait(0);
+  }
+
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+  outb(0x1f2, PGSECTS);
+  outb(0x1f7, IDE_CMD_SETMUL);
+  idewait(0);
 }
 
 // Start the request for b.  Caller must hold idelock.
@@ -99,15 +135,87 @@ idestart(struct buf *b)
   }
 }
 
+// May swap use sectors [sector, sector+n) of disk dev? On the root
+// disk it may use the file system image, which holds the swap area
+// and any swap files; on the boot disk only the area past the
+// kernel that param.h sets aside.
+static int
+swapsectorsok(uint dev, uint sector, uint n)
+{
+  uint start, end;
+
+  if(dev == ROOTDEV){
+    start = 0;
+    end = FSSIZE * (BSIZE/SECTOR_SIZE);
+  } else {
+    start = BOOTSWAPSTART * (BSIZE/SECTOR_SIZE);
+    end = start + BOOTSWAPSLOTS*PGSECTS;
+  }
+  return sector >= start && sector + n <= end;
+}
+
+// Start the next queued swap transfer.  Caller must hold idelock
+// and the disk must be idle.
+static void
+swapstart(void)
+{
+  struct swapreq *s;
+
+  if((s = swapqueue) == 0)
+    return;
+  swapqueue = s->qnext;
+  swapactive = s;
+  if(!swapsectorsok(s->dev, s->sector, s->n*PGSECTS))
+    panic("incorrect swap sector");
+
+  idewait(0);
+  outb(0x3f6, 0);  // generate interrupt
+  outb(0x1f2, (s->n*PGSECTS) & 0xff);  // number of sectors; 0 means 256
+  outb(0x1f3, s->sector & 0xff);
+  outb(0x1f4, (s->sector >> 8) & 0xff);
+  outb(0x1f5, (s->sector >> 16) & 0xff);
+  outb(0x1f6, 0xe0 | ((s->dev&1)<<4) | ((s->sector>>24)&0x0f));
+  if(s->write){
+    outb(0x1f7, IDE_CMD_WRMUL);
+    outsl(0x1f0, s->addr[0], PGSIZE/4);
+  } else {
+    outb(0x1f7, IDE_CMD_RDMUL);
+  }
+}
+
 // Interrupt handler.
 void
 ideintr(void)
 {
   struct buf *b;
+  struct swapreq *s;
 
-  // First queued buffer is the active request.
   acquire(&idelock);
 
+  if((s = swapactive) != 0){
+    // Each interrupt moves one page of the run.
+    if(!s->write && idewait(1) >= 0)
+      insl(0x1f0, s->addr[s->cur], PGSIZE/4);
+    if(++s->cur < s->n){
+      if(s->write)
+        outsl(0x1f0, s->addr[s->cur], PGSIZE/4);
+      release(&idelock);
+      return;
+    }
+    swapactive = 0;
+    s->done = 1;
+    wakeup(s);
+
+    // File system requests get the next turn.
+    if(idequeue != 0)
+      idestart(idequeue);
+    else
+      swapstart();
+    release(&idelock);
+    return;
+  }
+
+  // First queued buffer is the active request.
   if((b = idequeue) == 0){
     release(&idelock);
     return;
@@ -123,8 +231,10 @@ ideintr(void)
   b->flags &= ~B_DIRTY;
   wakeup(b);
 
-  // Start disk on next buf in queue.
-  if(idequeue != 0)
+  // Start disk on next swap transfer or buf in queue.
+  if(swapqueue != 0)
+    swapstart();
+  else if(idequeue != 0)
     idestart(idequeue);
 
   release(&idelock);
@@ -155,7 +265,7 @@ iderw(struct buf *b)
   *pp = b;
 
   // Start disk if necessary.
-  if(idequeue == b)
+  if(idequeue == b && swapactive == 0)
     idestart(b);
 
   // Wait for request to finish.
@@ -166,3 +276,55 @@ iderw(struct buf *b)
 
   release(&idelock);
 }
+
+// Is there a disk dev to swap to?
+int
+idepresent(uint dev)
+{
+  return dev == 0 || (dev == 1 && havedisk1);
+}
+
+// Read or write a run of n pages of swap starting at sector on
+// dev, straight to or from the kernel addresses in addr.
+void
+iderwpages(uint dev, uint sector, char **addr, int n, int write)
+{
+  struct swapreq s, **pp;
+
+  if(dev != 0 && !havedisk1)
+    panic("iderwpages: ide disk 1 not present");
+  if(n < 1 || n*PGSECTS > 256)
+    panic("iderwpages: bad run");
+
+  s.dev = dev;
+  s.sector = sector;
+  s.addr = addr;
+  s.n = n;
+  s.cur = 0;
+  s.write = write;
+  s.done = 0;
+  s.qnext = 0;
+
+  acquire(&idelock);
+
+  for(pp=&swapqueue; *pp; pp=&(*pp)->qnext)
+    ;
+  *pp = &s;
+
+  // Start disk if it is idle.
+  if(swapactive == 0 && idequeue == 0)
+    swapstart();
+
+  while(!s.done)
+    sleep(&s, &idelock);
+
+  release(&idelock);
+}
+
+// Read or write one page of swap starting at sector on dev,
+// straight to or from the kernel address addr.
+void
+iderwpage(uint dev, uint sector, char *addr, int write)
+{
+  iderwpages(dev, sector, &addr, 1, write);
+}
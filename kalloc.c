@@ -12,7 +12,6 @@
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
-extern void checkAswap(void);
 struct run {
   struct run *next;
 };
@@ -21,6 +20,9 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  int nfree;    // Pages on freelist
+  int npages;   // Pages handed to the allocator by kinit
+  ushort ref[PHYSTOP/PGSIZE]; // References to each allocated page
 } kmem;
 
 // Initialization happens in two phases.
@@ -48,8 +50,10 @@ freerange(void *vstart, void *vend)
 {
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
-  for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
     kfree(p);
+    kmem.npages++;
+  }
 }
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
@@ -63,6 +67,8 @@ kfree(char *v)
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
+  if(kmem.ref[V2P(v)/PGSIZE] > 1)
+    panic("kfree: shared");
 
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
@@ -70,8 +76,10 @@ kfree(char *v)
   if(kmem.use_lock)
     acquire(&kmem.lock);
   r = (struct run*)v;
+  kmem.ref[V2P(v)/PGSIZE] = 0;
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   if(kmem.use_lock)
     release(&kmem.lock);
 }
@@ -83,26 +91,30 @@ char*
 kalloc(void)
 {
   struct run *r;
+  int again;
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  
-  if(kmem.freelist == 0){
-    
-    if(kmem.use_lock)
-        release(&kmem.lock);
-    checkAswap();
-
-    if(kmem.freelist == 0)
-      checkAswap();
-    if(kmem.use_lock)
-        acquire(&kmem.lock);
-    }
+
+  // Out of memory: kswapd did not keep up, so reclaim ourselves,
+  // batch by batch, until a page turns up or reclaim gives up.
+  while(kmem.freelist == 0 && kmem.use_lock){
+    release(&kmem.lock);
+    again = directreclaim();
+    acquire(&kmem.lock);
+    if(!again)
+      break;
+  }
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
-  if(kmem.use_lock)
+    kmem.nfree--;
+    kmem.ref[V2P(r)/PGSIZE] = 1;
+  }
+  if(kmem.use_lock){
     release(&kmem.lock);
+    kswapdwakeup(kmem.nfree);
+  }
 
   if(r)
     memset((char*)r, 5, PGSIZE);
@@ -110,21 +122,58 @@ kalloc(void)
   return (char*)r;
 }
 
-int kfreepage(void){
-    struct run* r;
-    int cnt = 0;
-    if(kmem.use_lock){
-        acquire(&kmem.lock);
-    }
-    r =  kmem.freelist;
-    while(r){
-        cnt++;
-        r = r->next;
-    }
-    if(kmem.use_lock){
-        release(&kmem.lock);
-    }
-
-    return cnt;
+// Add a reference to the allocated page at v, which is now
+// shared copy-on-write. Returns 0, taking no reference, if the
+// page has been freed meanwhile.
+int
+kref(char *v)
+{
+  int ok;
+
+  acquire(&kmem.lock);
+  ok = kmem.ref[V2P(v)/PGSIZE] > 0;
+  if(ok)
+    kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.lock);
+  return ok;
+}
+
+// Drop a reference to the page at v. Returns 1 if it was the
+// last one, in which case the caller must kfree() the page.
+int
+kunref(char *v)
+{
+  int last;
+
+  acquire(&kmem.lock);
+  last = kmem.ref[V2P(v)/PGSIZE] <= 1;
+  if(!last)
+    kmem.ref[V2P(v)/PGSIZE]--;
+  release(&kmem.lock);
+  return last;
 }
 
+// Number of references to the allocated page at v.
+int
+krefcount(char *v)
+{
+  return kmem.ref[V2P(v)/PGSIZE];
+}
+
+// Number of free pages.
+int
+kfreepage(void)
+{
+  return kmem.nfree;
+}
+
+// Report the allocator's page counts: pages it manages, pages on
+// the free list, and physical pages below PHYSTOP it never hands
+// out (kernel image, I/O hole).
+void
+kmemstat(int *total, int *free, int *reserved)
+{
+  *total = kmem.npages;
+  *free = kmem.nfree;
+  *reserved = PHYSTOP/PGSIZE - kmem.npages;
+}
@@ -0,0 +1,33 @@
+// Print the load control state: the recent swap-in rate, whether
+// the system is thrashing, and the processes suspended because of it.
+//   loadstat
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "loadstat.h"
+
+struct loadstat st;
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  if(argc != 1){
+    printf(2, "usage: loadstat\n");
+    exit();
+  }
+  if(loadstat(&st) < 0){
+    printf(2, "loadstat: failed\n");
+    exit();
+  }
+  printf(1, "%s: %d swap-ins in %d ticks (high %d, low %d)\n",
+         st.thrashing ? "thrashing" : "ok", st.rate, st.window, st.high, st.low);
+  printf(1, "suspended:");
+  for(i = 0; i < st.nsuspended; i++)
+    printf(1, " %d", st.suspended[i]);
+  printf(1, "\n");
+  exit();
+}
@@ -0,0 +1,10 @@
+// Load control state returned by loadstat(). Needs param.h.
+struct loadstat {
+  int thrashing;          // Swap-in rate went above high
+  uint rate;              // Pages swapped in during the last window
+  uint window;            // Window length in ticks
+  uint high;              // Rate at which the system is thrashing
+  uint low;               // Rate below which processes are readmitted
+  int nsuspended;         // Processes held back by load control
+  int suspended[NPROC];   // Their pids
+};
@@ -0,0 +1,6 @@
+// Advice values for madvise().
+#define MADV_NORMAL     0  // No special treatment
+#define MADV_RANDOM     1  // Random access expected: no readahead
+#define MADV_SEQUENTIAL 2  // Sequential access expected: read far ahead
+#define MADV_WILLNEED   3  // Access expected soon: prefetch swapped pages
+#define MADV_DONTNEED   4  // Contents no longer needed: drop the pages
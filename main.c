@@ -33,9 +33,11 @@ main(void)
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
+  swapInit();      // swap slot allocator
   userinit();      // first user process
+  kthread("kswapd", kswapd); // background page reclaim
+  kthread("kprefetch", kprefetch); // madvise(MADV_WILLNEED) swap-in
   mpmain();        // finish this processor's setup
-  swapInit();
 }
 
 // Other CPUs jump here from entryother.S.
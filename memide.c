@@ -58,3 +58,39 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// Only the file system image, disk 1, is in memory.
+int
+idepresent(uint dev)
+{
+  return dev == 1;
+}
+
+// Read or write a run of n pages of swap starting at sector on dev.
+void
+iderwpages(uint dev, uint sector, char **addr, int n, int write)
+{
+  uchar *p;
+  int i;
+
+  if(dev != 1)
+    panic("iderwpages: request not for disk 1");
+  if(sector + n*(PGSIZE/BSIZE) > disksize)
+    panic("iderwpages: sector out of range");
+
+  p = memdisk + sector*BSIZE;
+
+  for(i = 0; i < n; i++, p += PGSIZE){
+    if(write)
+      memmove(p, addr[i], PGSIZE);
+    else
+      memmove(addr[i], p, PGSIZE);
+  }
+}
+
+// Read or write one page of swap starting at sector on dev.
+void
+iderwpage(uint dev, uint sector, char *addr, int write)
+{
+  iderwpages(dev, sector, &addr, 1, write);
+}
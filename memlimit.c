@@ -0,0 +1,67 @@
+// Show the memory limits of a process, or run a command under
+// changed ones. A process may only set its own limits and its
+// children's, so limits are changed for a new command rather than
+// for a running process.
+//   memlimit pid                      print them
+//   memlimit name value ... cmd arg.. run cmd with them set; name is
+//                                     rss or swap (pages, 0 for no
+//                                     limit) or adj (OOM badness
+//                                     adjustment) or mlock (pages it
+//                                     may pin)
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "memlimit.h"
+
+static int
+number(char *s)
+{
+  return s[0] == '-' ? -atoi(s + 1) : atoi(s);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct memlimit ml;
+  int pid, i;
+
+  if(argc == 2 && argv[1][0] >= '0' && argv[1][0] <= '9'){
+    pid = atoi(argv[1]);
+    if(memlimit(pid, &ml, 0) < 0){
+      printf(2, "memlimit: no process %d\n", pid);
+      exit();
+    }
+    printf(1, "pid %d rss %d swap %d adj %d mlock %d\n",
+           pid, ml.rss, ml.swap, ml.oomadj, ml.mlock);
+    exit();
+  }
+
+  if(argc < 4 || memlimit(getpid(), &ml, 0) < 0){
+    printf(2, "usage: memlimit pid | memlimit [rss|swap|adj|mlock value]... cmd [arg]...\n");
+    exit();
+  }
+  for(i = 1; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "rss") == 0)
+      ml.rss = number(argv[i+1]);
+    else if(strcmp(argv[i], "swap") == 0)
+      ml.swap = number(argv[i+1]);
+    else if(strcmp(argv[i], "adj") == 0)
+      ml.oomadj = number(argv[i+1]);
+    else if(strcmp(argv[i], "mlock") == 0)
+      ml.mlock = number(argv[i+1]);
+    else
+      break;
+  }
+  if(i == 1 || i >= argc){
+    printf(2, "usage: memlimit pid | memlimit [rss|swap|adj|mlock value]... cmd [arg]...\n");
+    exit();
+  }
+  if(memlimit(getpid(), &ml, 1) < 0){
+    printf(2, "memlimit: invalid limits\n");
+    exit();
+  }
+  exec(argv[i], argv + i);
+  printf(2, "memlimit: exec %s failed\n", argv[i]);
+  exit();
+}
@@ -0,0 +1,11 @@
+// Per-process memory limits, read and set with memlimit().
+// A limit of 0 means no limit.
+struct memlimit {
+  int rss;              // Most pages resident at once
+  int swap;             // Most pages swapped out at once
+  int oomadj;           // Pages added to the OOM badness score
+  int mlock;            // Most pages pinned by mlock() at once, at
+                        // most 1/MLOCKSHARE of memory
+};
+
+#define OOM_DISABLE (-1000)  // oomadj that exempts a process from the OOM killer
@@ -11,7 +11,7 @@
 #include "stat.h"
 #include "param.h"
 
-#define NSWAPBLOCKS (800*8)
+#define NSWAPBLOCKS (FSSWAPSLOTS*8)
 #ifndef static_assert
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
@@ -101,7 +101,9 @@ main(int argc, char *argv[])
   sb.nlog = xint(nlog);
   sb.logstart = xint(2+NSWAPBLOCKS);
   sb.inodestart = xint(2+nlog+NSWAPBLOCKS);
-  sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.bmapstart = xint(2+NSWAPBLOCKS+nlog+ninodeblocks);
+  sb.swapstart = xint(2);
+  sb.nswap = xint(NSWAPBLOCKS);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
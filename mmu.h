@@ -94,7 +94,11 @@ struct segdesc {
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
+#define PTE_Z           0x200   // Not present: held in the compressed pool
+#define PTE_EVICT       0x400   // Not present: being swapped out
+#define PTE_COW         0x800   // Shared copy-on-write; PTE_W is clear
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
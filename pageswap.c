@@ -8,27 +8,87 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
-#include "buf.h"
-
-struct run {
-    struct run *next;
-  };
+#include "file.h"
+#include "swapctl.h"
+#include "vmstat.h"
+#include "zswap.h"
+#include "madvise.h"
 
 // Structure for swap slots
 struct swap_slot {
   int page_perm;  // Permission of swapped memory page
-  int is_free;    // Availability of swap slot
+  int ref;        // PTEs and swap cache frames using the slot
+};
+
+#define FILESLOTS  (MAXFILE*BSIZE/PGSIZE)  // Most slots in a swap file
+
+// A swap device: a run of page-sized slots on a disk, or the pages
+// of a swap file. Each device owns a range of slot numbers starting
+// at a bitmap word boundary, so a PTE names a slot without saying
+// which disk it is on.
+struct swapdev {
+  int dev;                      // Disk holding the slots
+  uint start;                   // First block of slot 0
+  int file;                     // Slots are at map[] rather than start
+  uint map[FILESLOTS];          // First block of each swap file slot
+  int base;                     // Slot number of its first slot
+  int nslots;                   // Number of slots
+  int prio;                     // Higher priority devices fill first
+  int hint;                     // Word to start the next search at
+  int nfree;                    // Number of free slots
 };
 
-// Array of swap slots
+// Array of swap slots. Free slots are tracked in a bitmap (bit set
+// means the slot is in use) so allocation scans a word at a time
+// starting from a hint cursor instead of walking every slot. Slot
+// numbers not backed by a device stay marked in use.
 struct {
   struct spinlock lock;
-  struct swap_slot slots[800];  // 800 swap slots as per assignment
+  struct swap_slot slots[NSWAPSLOTS];
+  uint inuse[SWAPMAPWORDS];     // Bitmap of allocated slots
+  struct swapdev devs[NSWAPDEV];
+  int ndev;                     // Devices in use
+  int nextbase;                 // Slot number for the next device
+  int nslots;                   // Slots over all devices
+  int nfree;                    // Free slots over all devices
+  int rr;                       // Device that took the last slot
 } swap_area;
 
+extern struct {
+  struct spinlock lock;
+  struct proc proc[NPROC];
+} ptable;
+
+#define NFRAMES    (PHYSTOP/PGSIZE) // Physical page frames
+
+// Reverse map of resident user pages, indexed by physical frame
+// number. The CLOCK hand sweeps this table, so picking a victim
+// only touches the PTEs of pages that are actually resident.
+// A frame swapped back in keeps its swap slot (the swap cache):
+// until the page is written (PTE_D), the slot still holds an
+// identical copy and evicting it again needs no disk write.
+struct frame {
+  uint va;      // User virtual address the frame is mapped at
+  int inuse;    // Frame holds a resident user page
+  int slot;     // Swap slot with a copy of this page, or -1
+  int ra;       // Mapped by readahead and not yet seen in use
+  int locked;   // Pinned by mlock(); never evicted
+};
+
+struct {
+  struct spinlock lock;
+  struct frame frames[NFRAMES];
+  int hand;     // CLOCK hand: next frame to examine
+  int ncached;  // Frames holding a swap slot
+} frametable;
+
+#define SLOTBLOCKS (PGSIZE/BSIZE)   // Blocks per swap slot
+
 // Variables for adaptive page replacement
 int threshold = 100;        // Initial threshold
 int npages_to_swap = 4;     // Initial number of pages to swap (changed from 2 to 4 as per Piazza)
+int basethreshold = 100;    // threshold relaxes back to this
+int basenpages = 4;         // npages_to_swap relaxes back to this
 #ifdef ALPHA
 int alpha = ALPHA;          // Alpha value from Makefile
 #else
@@ -41,273 +101,1284 @@ int beta = 10;              // Default beta value
 #endif
 int limit = 100;            // Maximum number of pages to swap
 
+#define KSWAPD_BACKOFF 100   // Ticks kswapd idles after a fruitless pass
+#define SWAPBATCH      16    // Pages swapped out per TLB shootdown
+#define RELAXTICKS     100   // Ticks between relaxation steps
+#define SWAPIDLE       500   // Ticks asleep before a whole process is swapped out
+#define FREEBEHIND     (2*SWAPRUN) // Pages behind a MADV_SEQUENTIAL fault to release
+#define NPREFETCH      8     // MADV_WILLNEED ranges waiting for kprefetch
+
+// Swap-in readahead. A fault also reads up to ra_window following
+// pages whose slots follow on disk. The window grows on each
+// readahead page that turns out to be used and shrinks on each
+// one that is released untouched. At zero it reopens when faults
+// come in at consecutive addresses.
+int ra_window = 2;          // Pages read ahead per fault
+static uint ra_lastfault;   // Page of the last swap-in fault
+
+// Event counters reported by getvmstat(). They are updated without
+// a lock, so a count may occasionally be lost.
+struct vmstat vmstat;
+
+// Held while evicting pages, so kswapd and direct reclaim from
+// kalloc() never pick the same victim page at the same time.
+struct sleeplock reclaimlock;
+
+// Held while swapping pages in; see swapin().
+struct sleeplock swapinlock;
+
+static int kswapd_sleeping;  // kswapd is waiting for the low watermark
 
-// Function to duplicate a swap slot for fork
+// Ranges queued by madvise(MADV_WILLNEED) for kprefetch() to swap in.
+struct {
+  struct spinlock lock;
+  struct {
+    struct proc *p;
+    uint start;
+    uint end;
+  } q[NPREFETCH];
+  int n;
+  struct proc *busy;  // Process whose range kprefetch() is reading
+  int cancel;         // Stop reading busy's range
+} prefetchq;
+
+
+// Return the device holding a slot. Devices are only ever added,
+// and a slot number is only handed out once its device is set up,
+// so no lock is needed.
+static struct swapdev*
+slotdev(int slot_index)
+{
+  struct swapdev *d;
+
+  for(d = swap_area.devs; d < &swap_area.devs[swap_area.ndev]; d++)
+    if(slot_index >= d->base && slot_index < d->base + d->nslots)
+      return d;
+  panic("slotdev");
+}
+
+// Return the first disk block of a slot.
+static uint
+slotblock(int slot_index)
+{
+  struct swapdev *d = slotdev(slot_index);
+
+  if(d->file)
+    return d->map[slot_index - d->base];
+  return d->start + (slot_index - d->base)*SLOTBLOCKS;
+}
+
+// Move the page held in a swap slot to or from addr with a single
+// disk command. Swap traffic does not go through the buffer cache.
+static void
+swapio(int slot_index, char *addr, int write)
+{
+  iderwpage(slotdev(slot_index)->dev, slotblock(slot_index), addr, write);
+}
+
+// Read n pages from slots starting at slot_index, which must be
+// consecutive on one disk, with a single disk command.
+static void
+swapiorun(int slot_index, char **addr, int n)
+{
+  iderwpages(slotdev(slot_index)->dev, slotblock(slot_index), addr, n, 0);
+}
+
+// Return the slot a swapped-out PTE refers to, or -1.
+static int
+pteslot(pte_t *pte)
+{
+  if(!pte || (*pte & (PTE_P|PTE_Z|PTE_EVICT)) || *pte == 0)
+    return -1;
+  return PTE_ADDR(*pte) >> 12;
+}
+
+// Pick a slot for the page at va so that consecutive virtual pages
+// end up in consecutive slots: right after the slot of the page
+// below, or right before the slot of the page above.
+static int
+clusterslot(pde_t *pgdir, uint va)
+{
+  int s;
+
+  if(va >= PGSIZE && (s = pteslot(walkpgdir(pgdir, (void*)(va - PGSIZE), 0))) >= 0)
+    return findslotnear(s + 1);
+  if(va + PGSIZE < KERNBASE && (s = pteslot(walkpgdir(pgdir, (void*)(va + PGSIZE), 0))) >= 0)
+    return findslotnear(s - 1);
+  return findslot();
+}
+
+// Function to duplicate a swap slot for fork. Parent and child
+// share the slot: it gains a reference and is only freed when the
+// last PTE or swap cache frame referring to it lets go.
 int
 duplicateslot(int parent_slot)
 {
-  if(parent_slot < 0 || parent_slot >= 800 || swap_area.slots[parent_slot].is_free) {
+  if(parent_slot < 0 || parent_slot >= NSWAPSLOTS || !slotinuse(parent_slot)) {
+    return -1; // Invalid slot or slot is free
+  }
+
+  acquire(&swap_area.lock);
+  swap_area.slots[parent_slot].ref++;
+  release(&swap_area.lock);
+  return parent_slot;
+}
+
+
+// Initialize swap area
+void
+swapInit(void)
+{
+  int i;
+
+  initlock(&swap_area.lock, "swap_area");
+  initsleeplock(&reclaimlock, "reclaim");
+  initsleeplock(&swapinlock, "swapin");
+  initlock(&prefetchq.lock, "prefetch");
+  initlock(&frametable.lock, "frametable");
+  zswapinit();
+
+  acquire(&swap_area.lock);
+  // No slot is free until swapdevinit() adds the devices.
+  for(i = 0; i < SWAPMAPWORDS; i++)
+    swap_area.inuse[i] = 0xFFFFFFFF;
+  for(i = 0; i < NSWAPSLOTS; i++){
+    swap_area.slots[i].page_perm = 0;
+    swap_area.slots[i].ref = 0;
+  }
+  swap_area.ndev = 0;
+  swap_area.nextbase = 0;
+  swap_area.nslots = 0;
+  swap_area.nfree = 0;
+  swap_area.rr = 0;
+  release(&swap_area.lock);
+}
+
+// Add nslots slots on disk dev as a swap device. The slots are
+// consecutive from block start, or, if map is not 0, start at the
+// blocks it lists. Returns 0, or -1 if the device table or the slot
+// numbers have run out or map is already in use.
+int
+swapadddev(int dev, uint start, uint *map, int nslots, int prio)
+{
+  struct swapdev *d;
+  int i;
+
+  if(nslots <= 0 || (map && nslots > FILESLOTS))
+    return -1;
+  acquire(&swap_area.lock);
+  if(swap_area.ndev == NSWAPDEV || swap_area.nextbase + nslots > NSWAPSLOTS){
+    release(&swap_area.lock);
+    return -1;
+  }
+  for(d = swap_area.devs; map && d < &swap_area.devs[swap_area.ndev]; d++){
+    if(d->file && d->dev == dev && d->map[0] == map[0]){
+      release(&swap_area.lock);
+      return -1;
+    }
+  }
+  d = &swap_area.devs[swap_area.ndev];
+  d->dev = dev;
+  d->start = map ? map[0] : start;
+  d->file = map != 0;
+  for(i = 0; map && i < nslots; i++)
+    d->map[i] = map[i];
+  d->base = swap_area.nextbase;
+  d->nslots = nslots;
+  d->prio = prio;
+  d->hint = 0;
+  d->nfree = nslots;
+  for(i = d->base; i < d->base + nslots; i++)
+    swap_area.inuse[i/32] &= ~(1U << (i%32));
+  swap_area.nextbase = (d->base + nslots + 31) / 32 * 32;
+  swap_area.nslots += nslots;
+  swap_area.nfree += nslots;
+  swap_area.ndev++;
+  release(&swap_area.lock);
+
+  cprintf("swap: dev %d start %d slots %d prio %d%s\n", dev, d->start,
+          nslots, prio, map ? " file" : "");
+  return 0;
+}
+
+// Swap to the pages of the regular file ip, which the caller has
+// locked and keeps a reference to for as long as the kernel runs.
+// The file's block list is read once here; swap I/O then goes to
+// those blocks directly, without the inode or the log. A page of
+// the file whose blocks are not consecutive on disk is skipped.
+// From then on the file cannot be written, truncated or unlinked.
+int
+swapfile(struct inode *ip, int prio)
+{
+  uint map[FILESLOTS], b;
+  int n, pg, i;
+
+  n = 0;
+  for(pg = 0; pg < FILESLOTS && (pg+1)*PGSIZE <= ip->size; pg++){
+    b = ibmap(ip, pg*SLOTBLOCKS);
+    for(i = 1; i < SLOTBLOCKS; i++)
+      if(ibmap(ip, pg*SLOTBLOCKS + i) != b + i)
+        break;
+    if(i == SLOTBLOCKS)
+      map[n++] = b;
+  }
+  if(ip->swap || swapadddev(ip->dev, 0, map, n, prio) < 0)
+    return -1;
+  ip->swap = 1;
+  return 0;
+}
+
+// Set up the swap devices once the root file system is readable:
+// the area mkfs reserves on the root disk and, when it is a separate
+// drive, the boot disk past the kernel image. Both have the same
+// priority, so page-outs alternate between the two disks.
+void
+swapdevinit(void)
+{
+  extern struct superblock sb;
+
+  if(sb.nswap >= SLOTBLOCKS)
+    swapadddev(ROOTDEV, sb.swapstart, 0, sb.nswap/SLOTBLOCKS, 0);
+  if(ROOTDEV != 0 && idepresent(0))
+    swapadddev(0, BOOTSWAPSTART, 0, BOOTSWAPSLOTS, 0);
+}
+
+static int frameslot(uint, int);
+static int cansleep(void);
+static void rafinish(struct frame*, int);
+static int releaseframe(pde_t*, uint, uint);
+
+// Record that frame pa now holds the user page at va.
+void
+frameadd(uint pa, uint va)
+{
+  struct frame *f = &frametable.frames[pa/PGSIZE];
+
+  acquire(&frametable.lock);
+  f->va = va;
+  f->inuse = 1;
+  f->slot = -1;
+  f->ra = 0;
+  f->locked = 0;
+  release(&frametable.lock);
+}
+
+// Frame pa no longer holds a user page. Its swap cache slot, if
+// any, is no longer needed either. accessed is the page's PTE_A,
+// which settles whether a readahead page was used.
+void
+framedel(uint pa, int accessed)
+{
+  struct frame *f = &frametable.frames[pa/PGSIZE];
+  int slot;
+
+  acquire(&frametable.lock);
+  if(f->ra)
+    rafinish(f, accessed);
+  f->inuse = 0;
+  f->locked = 0;
+  slot = frameslot(pa, -1);
+  release(&frametable.lock);
+  if(slot >= 0)
+    freeslot(slot);
+}
+
+// Set the swap slot cached for frame pa and return the old one.
+// Caller must hold frametable.lock.
+static int
+frameslot(uint pa, int slot)
+{
+  struct frame *f = &frametable.frames[pa/PGSIZE];
+  int old = f->slot;
+
+  if(old < 0 && slot >= 0)
+    frametable.ncached++;
+  else if(old >= 0 && slot < 0)
+    frametable.ncached--;
+  f->slot = slot;
+  return old;
+}
+
+// Release every swap cache slot so that their space can be used
+// for other pages. Called when swap runs out of free slots.
+static void
+swapcachedrop(void)
+{
+  int i, slot;
+
+  for(i = 0; i < NFRAMES; i++){
+    acquire(&frametable.lock);
+    slot = -1;
+    if(frametable.frames[i].inuse)
+      slot = frameslot(i*PGSIZE, -1);
+    release(&frametable.lock);
+    if(slot >= 0)
+      freeslot(slot);
+  }
+}
+
+// A readahead page was used (hit) or released unused (miss);
+// adapt the window. Caller must hold frametable.lock.
+static void
+rafinish(struct frame *f, int hit)
+{
+  f->ra = 0;
+  if(hit){
+    vmstat.rahits++;
+    if(ra_window < SWAPRUN-1)
+      ra_window++;
+  } else {
+    vmstat.ramisses++;
+    if(ra_window > 0)
+      ra_window--;
+  }
+}
+
+// Is frame pa pinned by mlock()? framepin() looks at the PTE and
+// sets the flag under frametable.lock, and eviction checks the flag
+// under the lock after taking the PTE away, so one of the two always
+// sees the other.
+int
+framelocked(uint pa)
+{
+  int locked;
+
+  acquire(&frametable.lock);
+  locked = frametable.frames[pa/PGSIZE].locked;
+  release(&frametable.lock);
+  return locked;
+}
+
+// Pin or unpin the frame mapped at va. Returns whether it was
+// pinned before, or -1 if the page is not present or still shared
+// copy-on-write.
+static int
+framepin(pde_t *pgdir, uint va, int pin)
+{
+  struct frame *f;
+  pte_t *pte;
+  int old;
+
+  acquire(&frametable.lock);
+  pte = walkpgdir(pgdir, (void*)va, 0);
+  if(!pte || !(*pte & PTE_P) || (pin && (*pte & PTE_COW))){
+    release(&frametable.lock);
+    return -1;
+  }
+  f = &frametable.frames[PTE_ADDR(*pte)/PGSIZE];
+  old = f->locked;
+  f->locked = pin;
+  release(&frametable.lock);
+  return old;
+}
+
+// Number of pages below sz pinned by mlock().
+int
+lockedpages(pde_t *pgdir, uint sz)
+{
+  pte_t *pte;
+  uint va;
+  int n = 0;
+
+  for(va = 0; (pte = nextpte(pgdir, &va, sz)) != 0; va += PGSIZE)
+    if((*pte & PTE_P) && framelocked(PTE_ADDR(*pte)))
+      n++;
+  return n;
+}
+
+// Pin the current process's pages in [addr, addr+len) in memory.
+// Each page is faulted in now and given a private frame if it is
+// shared copy-on-write, so that the pin survives writes; reclaim
+// then skips the frame. Fails once the process would have more than
+// its mlocklimit pages pinned.
+int
+mlock(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint a;
+  int r;
+
+  if(addr + len < addr || addr + len > p->sz)
+    return -1;
+  for(a = PGROUNDDOWN(addr); a < addr + len; a += PGSIZE){
+    while((r = framepin(p->pgdir, a, 1)) < 0){
+      // Not present or copy-on-write: fix that and try again.
+      pte = walkpgdir(p->pgdir, (void*)a, 0);
+      if(pte && (*pte & PTE_P)){
+        if(cowcopy(p->pgdir, a) < 0)
+          return -1;
+      } else if(swappage_in(p->pgdir, (void*)a) < 0)
+        return -1;
+    }
+    if(r == 0 && p->mlocked >= p->mlocklimit){
+      framepin(p->pgdir, a, 0);
+      return -1;
+    }
+    if(r == 0)
+      p->mlocked++;
+  }
+  return 0;
+}
+
+// Unpin the current process's pages in [addr, addr+len).
+int
+munlock(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  uint a;
+
+  if(addr + len < addr || addr + len > p->sz)
+    return -1;
+  for(a = PGROUNDDOWN(addr); a < addr + len; a += PGSIZE)
+    if(framepin(p->pgdir, a, 0) == 1)
+      p->mlocked--;
+  return 0;
+}
+
+// Is the slot currently allocated?
+// Caller need not hold swap_area.lock; the answer is a snapshot.
+int
+slotinuse(int slot_index)
+{
+  return swap_area.slots[slot_index].ref > 0;
+}
+
+// Mark a free slot allocated. Caller must hold swap_area.lock.
+static void
+slottake(struct swapdev *d, int slot_index)
+{
+  swap_area.inuse[slot_index/32] |= 1U << (slot_index%32);
+  swap_area.slots[slot_index].ref = 1;
+  d->nfree--;
+  swap_area.nfree--;
+}
+
+// Pick the device for the next slot: the highest priority one with
+// free slots, taking devices of equal priority in turn so page-outs
+// are striped across them. Caller must hold swap_area.lock.
+static struct swapdev*
+pickdev(void)
+{
+  struct swapdev *d, *best;
+  int i;
+
+  best = 0;
+  for(i = 1; i <= swap_area.ndev; i++){
+    d = &swap_area.devs[(swap_area.rr + i) % swap_area.ndev];
+    if(d->nfree > 0 && (best == 0 || d->prio > best->prio))
+      best = d;
+  }
+  if(best)
+    swap_area.rr = best - swap_area.devs;
+  return best;
+}
+
+// Find a free swap slot
+int
+findslot(void)
+{
+  struct swapdev *d;
+  int i, w, bit, nwords;
+  uint word;
+
+  acquire(&swap_area.lock);
+  if((d = pickdev()) == 0){
+    release(&swap_area.lock);
+    return -1;  // No free slot found
+  }
+  // d->nfree > 0 guarantees some word of d has a clear bit.
+  nwords = (d->nslots + 31) / 32;
+  for(i = 0; i < nwords; i++){
+    w = d->base/32 + (d->hint + i) % nwords;
+    word = swap_area.inuse[w];
+    if(word == 0xFFFFFFFF)
+      continue;
+    for(bit = 0; word & (1U << bit); bit++)
+      ;
+    slottake(d, w*32 + bit);
+    d->hint = w - d->base/32;
+    release(&swap_area.lock);
+    return w*32 + bit;
+  }
+  release(&swap_area.lock);
+  panic("findslot: nfree");
+}
+
+// Allocate slot want if it is free, otherwise any free slot.
+int
+findslotnear(int want)
+{
+  if(want >= 0 && want < NSWAPSLOTS){
+    acquire(&swap_area.lock);
+    if(!((swap_area.inuse[want/32] >> (want%32)) & 1)){
+      slottake(slotdev(want), want);
+      release(&swap_area.lock);
+      return want;
+    }
+    release(&swap_area.lock);
+  }
+  return findslot();
+}
+
+// Drop a reference to a swap slot, freeing it with the last one
+void
+freeslot(int slot_index)
+{
+  struct swapdev *d;
+
+  if(slot_index < 0 || slot_index >= NSWAPSLOTS)
+    return;
+
+  acquire(&swap_area.lock);
+  if(slotinuse(slot_index) && --swap_area.slots[slot_index].ref == 0){
+    d = slotdev(slot_index);
+    swap_area.inuse[slot_index/32] &= ~(1U << (slot_index%32));
+    d->nfree++;
+    swap_area.nfree++;
+    // Freed slots are reused first so swap stays packed at the front.
+    if(slot_index/32 - d->base/32 < d->hint)
+      d->hint = slot_index/32 - d->base/32;
+    swap_area.slots[slot_index].page_perm = 0;
+  }
+  release(&swap_area.lock);
+}
+
+// Number of references to an allocated slot. A slot shared after
+// fork must not be overwritten with one process's changes.
+static int
+slotrefs(int slot_index)
+{
+  return swap_area.slots[slot_index].ref;
+}
+
+// Number of free swap slots, for exhaustion checks without scanning.
+int
+swapfreeslots(void)
+{
+  return swap_area.nfree;
+}
+
+// Count free pages in memory
+int
+countpages(void)
+{
+  return kfreepage();
+}
+
+// Store the page at pa, which is still mapped at va: in the
+// compressed pool if it fits, otherwise in swap slot slot (or a
+// new one if slot is -1). slot is released if the page goes to the
+// pool. Sets *npte to the swapped-out PTE without its flags.
+static int
+storepage(pde_t *pgdir, uint va, uint pa, int slot, pte_t *npte)
+{
+  int h;
+
+  if((h = zstore((char*)P2V(pa))) >= 0){
+    if(slot >= 0)
+      freeslot(slot);
+    *npte = (h << 12) | PTE_Z;
+    return 0;
+  }
+  if(slot < 0 && (slot = clusterslot(pgdir, va)) < 0){
+    swapcachedrop();
+    if((slot = findslot()) < 0)
+      return -1;  // No free slot available
+  }
+  swapio(slot, (char*)P2V(pa), 1);
+  *npte = slot << 12;
+  return 0;
+}
+
+// Set a PTE that was marked PTE_EVICT and wake up processes
+// waiting for it in swapwait().
+static void
+swapsetpte(pte_t *pte, pte_t val)
+{
+  acquire(&swap_area.lock);
+  *pte = val;
+  wakeup(pte);
+  release(&swap_area.lock);
+}
+
+// Wait until a page is no longer being swapped out.
+void
+swapwait(pte_t *pte)
+{
+  acquire(&swap_area.lock);
+  while(*pte & PTE_EVICT)
+    sleep(pte, &swap_area.lock);
+  release(&swap_area.lock);
+}
+
+// First half of swapping out the page at va, frame pa: replace
+// its PTE with one marked PTE_EVICT, which is not present but
+// still holds the frame, and set *old to the previous PTE. Once
+// the caller has flushed the page from every TLB (tlbflush) the
+// page can no longer change, and swapstore() finishes the job.
+static int
+swapunmap(pde_t *pgdir, uint va, uint pa, pte_t *old)
+{
+  pte_t *pte = walkpgdir(pgdir, (void*)va, 0);
+
+  if(!pte || !(*pte & PTE_P) || PTE_ADDR(*pte) != pa)
+    return -1;  // Page not present
+  *old = xchg(pte, (*pte & ~(PTE_P|PTE_A|PTE_D)) | PTE_EVICT);
+  if(!(*old & PTE_P) || PTE_ADDR(*old) != pa || framelocked(pa)){
+    swapsetpte(pte, *old);  // Changed or pinned under us
+    return -1;
+  }
+  return 0;
+}
+
+// Second half of swapping out a page. It goes to the compressed
+// pool, or to disk if it compresses badly or the pool is full. A
+// clean page whose frame still has its swap cache slot is not
+// stored again. On failure the page is mapped back.
+static int
+swapstore(pde_t *pgdir, uint va, uint pa, pte_t old)
+{
+    pte_t npte, flags;
+    int slot_index;
+
+    pte_t *pte = walkpgdir(pgdir, (void*)va, 0);
+
+    acquire(&frametable.lock);
+    slot_index = frameslot(pa, -1);
+    release(&frametable.lock);
+
+    // The page has been out of every TLB since swapunmap(), so the
+    // PTE_D in old is final.
+    flags = PTE_FLAGS(old) & ~(PTE_P|PTE_A|PTE_D);
+    if(slot_index >= 0 && !(old & PTE_D))
+        npte = slot_index << 12;
+    else {
+        // The cached slot is shared with a forked process that still
+        // wants the old contents: store the changed page elsewhere.
+        if(slot_index >= 0 && slotrefs(slot_index) > 1){
+            freeslot(slot_index);
+            slot_index = -1;
+        }
+        if(storepage(pgdir, va, pa, slot_index, &npte) < 0){
+            swapsetpte(pte, old);  // Keep it resident
+            return -1;
+        }
+    }
+
+    // Save the page permissions
+    if(!(npte & PTE_Z)){
+        acquire(&swap_area.lock);
+        swap_area.slots[npte >> 12].page_perm = flags;
+        release(&swap_area.lock);
+    }
+
+    // Point the PTE at the pool entry or swap slot, keeping the
+    // permission bits
+    swapsetpte(pte, npte | flags);
+    vmstat.swapouts++;
+    
+    //cprintf("Swapped out page at VA 0x%x to slot %d\n", va, slot_index);
+    return 0;
+}
+
+// Function to swap out a single page.
+int 
+swappageout(pde_t *pgdir, uint va, uint pa) 
+{
+  pte_t old;
+
+  if(swapunmap(pgdir, va, pa, &old) < 0)
+    return -1;
+  tlbflush(pgdir, &va, 1);
+  return swapstore(pgdir, va, pa, old);
+}
+
+// Bring back a page of p held in the compressed pool.
+static int
+zswapin(struct proc *p, pde_t *pgdir, uint va, pte_t *pte)
+{
+  int h = PTE_ADDR(*pte) >> 12;
+  uint perm = (PTE_FLAGS(*pte) & ~PTE_Z) | PTE_P;
+  char *mem;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  if(zload(h, mem) < 0 || mappages(pgdir, (void*)va, PGSIZE, V2P(mem), perm) < 0){
+    kfree(mem);
+    return -1;
+  }
+  zfree(h);
+  frameadd(V2P(mem), va);
+  vmstat.swapins++;
+
+  if(p) p->rss++;
+  return 0;
+}
+
+
+// Swap in the page of p at page_addr, reading up to window more
+// pages whose slots follow its slot in the same disk command. If ra
+// is set the extra pages count as readahead for the hit statistics.
+// Returns 1 if it read the swap disk, 0 if the page was present or
+// held in memory, -1 on failure. Caller must hold swapinlock.
+static int
+swapin1(struct proc *p, pde_t *pgdir, uint page_addr, int window, int ra)
+{
+  pte_t *pte = walkpgdir(pgdir, (void*)page_addr, 0);
+  if(!pte) {
+    return -1; // No PTE for this address
+  }
+  if(*pte & PTE_EVICT)
+    swapwait(pte);  // Being swapped out; wait and swap it back in
+  
+  if(*pte & PTE_P) {
+    return 0; // Page already present
+  }
+  if(*pte == 0) {
+    return -1; // Never mapped, not swapped out
+  }
+  if(*pte & PTE_Z)
+    return zswapin(p, pgdir, page_addr, pte);
+  
+  // Extract the slot index from the PTE
+  int slot_index = PTE_ADDR(*pte) >> 12;
+  
+  if(slot_index < 0 || slot_index >= NSWAPSLOTS || !slotinuse(slot_index)) {
     return -1; // Invalid slot or slot is free
   }
   
-  // Find a new free slot for the child
-  int child_slot = findslot();
+  // Allocate a new physical page; kalloc() reclaims if it must
+  char *mem[SWAPRUN];
+  if((mem[0] = kalloc()) == 0) {
+    return -1; // Out of memory
+  }
+
+  // Read ahead the following pages whose slots follow this one on
+  // disk, as long as that does not push memory below the watermark.
+  int n = 1;
+  while(n <= window && page_addr + n*PGSIZE < KERNBASE &&
+        countpages() > threshold + 1){
+    if(pteslot(walkpgdir(pgdir, (void*)(page_addr + n*PGSIZE), 0)) != slot_index + n ||
+       slot_index + n >= NSWAPSLOTS || !slotinuse(slot_index + n) ||
+       slotdev(slot_index + n) != slotdev(slot_index) ||
+       slotblock(slot_index + n) != slotblock(slot_index) + n*SLOTBLOCKS)
+      break;
+    if((mem[n] = kalloc()) == 0)
+      break;
+    n++;
+  }
   
-  // If no free slot is available, try to swap out more pages to free up slots
-  if(child_slot < 0) {
-    // Try to free up some memory by swapping
-    checkAswap();
-    
-    // Try again
-    child_slot = findslot();
-    
-    // If still no free slot, try one more aggressive swap
-    if(child_slot < 0) {
-        checkAswap();
-      child_slot = findslot();
-      
-      if(child_slot < 0) {
-        return -1; // Still no free slots available
-      }
+  // Read the pages from disk with one command
+  swapiorun(slot_index, mem, n);
+  
+  int i;
+  for(i = 0; i < n; i++){
+    uint a = page_addr + i*PGSIZE;
+    int slot = slot_index + i;
+
+    // Restore the page permissions
+    uint perm;
+    acquire(&swap_area.lock);
+    perm = swap_area.slots[slot].page_perm;
+    release(&swap_area.lock);
+  
+    // Make sure PTE_P is set in the permissions
+    perm |= PTE_P;
+  
+    // Map the physical page to the virtual address
+    if(mappages(pgdir, (void*)a, PGSIZE, V2P(mem[i]), perm) < 0) {
+      int j;
+      for(j = i; j < n; j++)
+        kfree(mem[j]);
+      n = i;
+      break;
+    }
+    frameadd(V2P(mem[i]), a);
+  
+    // Keep the swap slot as the page's swap cache copy
+    acquire(&frametable.lock);
+    frameslot(V2P(mem[i]), slot);
+    frametable.frames[V2P(mem[i])/PGSIZE].ra = ra && i > 0;
+    release(&frametable.lock);
+  }
+  
+  if(n == 0)
+    return -1;
+
+  // Increment the rss count
+  if(p) p->rss += n;
+  vmstat.swapins += n;
+  
+  return 1;
+}
+
+// Swap in pages with swapin1(). Swap-ins are serialized so that the
+// prefetcher and a process faulting on the same page do not both
+// map it.
+static int
+swapin(struct proc *p, pde_t *pgdir, uint page_addr, int window, int ra)
+{
+  int r;
+
+  acquiresleep(&swapinlock);
+  r = swapin1(p, pgdir, page_addr, window, ra);
+  releasesleep(&swapinlock);
+  return r;
+}
+
+// Return the madvise() access pattern hint for va in p.
+static int
+getadvice(struct proc *p, uint va)
+{
+  struct vmadvice *v;
+
+  for(v = p->advice; v < &p->advice[NADVISE]; v++)
+    if(v->advice && va >= v->start && va < v->end)
+      return v->advice;
+  return MADV_NORMAL;
+}
+
+// Free-behind for MADV_SEQUENTIAL: the page FREEBEHIND pages behind
+// a sequential fault will probably not be used again. If it is a
+// clean copy of a swap slot it is dropped now, which costs no disk
+// write; otherwise its PTE_A is cleared so that reclaim takes it
+// first.
+static void
+freebehind(struct proc *p, uint va)
+{
+  pte_t *pte;
+  uint pa;
+  int cached;
+
+  if(va < FREEBEHIND*PGSIZE)
+    return;
+  va -= FREEBEHIND*PGSIZE;
+  pte = walkpgdir(p->pgdir, (void*)va, 0);
+  if(!pte || (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+    return;
+  pa = PTE_ADDR(*pte);
+  acquire(&frametable.lock);
+  cached = frametable.frames[pa/PGSIZE].slot >= 0;
+  release(&frametable.lock);
+  if(!cached || (*pte & PTE_D) || holdingsleep(&reclaimlock)){
+    atomicand(pte, ~PTE_A);
+    return;
+  }
+  acquiresleep(&reclaimlock);
+  if(swappageout(p->pgdir, va, pa) == 0){
+    p->rss--;
+    releaseframe(p->pgdir, va, pa);
+  }
+  releasesleep(&reclaimlock);
+}
+
+// Give p a zeroed frame at va, a page of its heap that sbrk()
+// reserved but that was never touched (or was discarded by
+// madvise(MADV_DONTNEED)).
+static int
+demandzero(struct proc *p, uint va)
+{
+  char *mem;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(p->pgdir, (void*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  frameadd(V2P(mem), va);
+  p->rss++;
+  vmstat.pgzeroed++;
+  return 0;
+}
+
+// Function to swap a page in for a page fault at va. A page below
+// the process size that has no mapping is filled with zeroes. How
+// far a swap-in reads ahead follows the process's madvise() hint
+// for the page: none for MADV_RANDOM, a full run with free-behind
+// for MADV_SEQUENTIAL, and otherwise the adaptive window. Returns 1
+// if it was read from the swap disk, 0 if it was present, held in
+// memory or zero-filled, -1 on failure.
+int
+swappage_in(pde_t *pgdir, void *va)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  int advice, r;
+
+  // Round down to page boundary
+  uint page_addr = PGROUNDDOWN((uint)va);
+
+  if(p && p->pgdir == pgdir && page_addr < p->sz &&
+     ((pte = walkpgdir(pgdir, (void*)page_addr, 0)) == 0 || *pte == 0))
+    return demandzero(p, page_addr);
+
+  advice = MADV_NORMAL;
+  if(p && p->pgdir == pgdir)
+    advice = getadvice(p, page_addr);
+  if(advice == MADV_RANDOM)
+    return swapin(p, pgdir, page_addr, 0, 0);
+  if(advice == MADV_SEQUENTIAL){
+    r = swapin(p, pgdir, page_addr, SWAPRUN-1, 1);
+    freebehind(p, page_addr);
+    return r;
+  }
+
+  // Sequential faults reopen a closed readahead window.
+  if(ra_window == 0 && page_addr == ra_lastfault + PGSIZE)
+    ra_window = 1;
+  ra_lastfault = page_addr;
+
+  return swapin(p, pgdir, page_addr, ra_window, 1);
+}
+
+// Bring the current process's pages in [va, va+len) into memory
+// before the kernel copies to or from them, so that running out of
+// memory fails the system call with -1 rather than faulting in the
+// middle of the copy. If write is set the kernel will store to the
+// pages, possibly holding a spinlock (piperead, consoleread), so
+// copy-on-write pages are also given their own frame now: that
+// fault could not sleep to reclaim memory. Returns -1 if a page is
+// not a user page or cannot be brought in.
+int
+faultin(uint va, uint len, int write)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (void*)a, 0);
+    if(!pte || !(*pte & PTE_P)){
+      if(swappage_in(p->pgdir, (void*)a) < 0)
+        return -1;
+      if((pte = walkpgdir(p->pgdir, (void*)a, 0)) == 0 || !(*pte & PTE_P))
+        continue;  // Gone again; the fault handler will cope
     }
+    if(!(*pte & PTE_U))
+      return -1;  // Stack guard page
+    if(write && (*pte & PTE_COW) && cowcopy(p->pgdir, a) < 0)
+      return -1;
   }
-  
-  // Copy the page permissions
-  acquire(&swap_area.lock);
-  swap_area.slots[child_slot].page_perm = swap_area.slots[parent_slot].page_perm;
-  release(&swap_area.lock);
-  
-  // Calculate block numbers for parent and child slots
-  uint parent_blockno = 2 + parent_slot * 8; // 2 blocks for boot and superblock
-  uint child_blockno = 2 + child_slot * 8;
-  
-  // Copy the page data from parent's slot to child's slot
-  for(int i = 0; i < 8; i++) {
-    struct buf *src_buf = bread(0, parent_blockno + i);
-    struct buf *dst_buf = bread(0, child_blockno + i);
-    memmove(dst_buf->data, src_buf->data, BSIZE);
-    bwrite(dst_buf);
-    brelse(src_buf);
-    brelse(dst_buf);
-  }
-  
-  return child_slot;
+  return 0;
 }
 
-
-// Initialize swap area
-void
-swapInit(void)
+// A page fault in the kernel on the user page at va could not get
+// memory, although faultin() brought the page in before: it was
+// swapped out again since. The copy cannot fail halfway, so the
+// access is retried, after a tick if the caller may sleep, by
+// which time reclaim or an exiting OOM victim has freed memory.
+// Copies made under a spinlock go to buffers that faultin() has
+// already given private frames, so such a retry never waits on a
+// copy-on-write copy that needs reclaim to succeed. Returns -1 if the access is a kernel bug instead (not a valid,
+// missing or copy-on-write user page), which must panic.
+int
+faultretry(uint va, int write)
 {
-  initlock(&swap_area.lock, "swap_area");
-  
-  acquire(&swap_area.lock);
-  for(int i = 0; i < 800; i++) {
-    swap_area.slots[i].is_free = 1;  // Mark all slots as free initially
-    swap_area.slots[i].page_perm = 0;
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint ticks0;
+
+  if(p == 0 || va >= p->sz)
+    return -1;
+  pte = walkpgdir(p->pgdir, (void*)va, 0);
+  if(pte && (*pte & PTE_P) && !(write && (*pte & PTE_COW)))
+    return -1;
+  if(cansleep()){
+    acquire(&tickslock);
+    ticks0 = ticks;
+    while(ticks == ticks0)
+      sleep(&ticks, &tickslock);
+    release(&tickslock);
   }
-  release(&swap_area.lock);
-  
-  cprintf("Swap area initialized with 800 slots\n");
+  return 0;
 }
 
-// Find a free swap slot
-int
-findslot(void)
+// Swap out pages of the current process until its RSS is back
+// within its limit, as far as its swap limit allows.
+void
+rsstrim(void)
 {
-  int i;
-  
-  acquire(&swap_area.lock);
-  for(i = 0; i < 800; i++) {
-    if(swap_area.slots[i].is_free) {
-      swap_area.slots[i].is_free = 0;  // Mark as used
-      release(&swap_area.lock);
-      return i;
-    }
+  struct proc *p = myproc();
+  uint va, pa;
+  int swapped;
+
+  if(p->rsslimit == 0 || p->rss <= p->rsslimit)
+    return;
+  swapped = swappedpages(p->pgdir, p->sz);
+  acquiresleep(&reclaimlock);
+  while(p->rss > p->rsslimit && (p->swaplimit == 0 || swapped < p->swaplimit)){
+    if((pa = findpage(p->pgdir, &va)) == 0 || swappageout(p->pgdir, va, pa) < 0)
+      break;
+    p->rss--;
+    swapped++;
+    releaseframe(p->pgdir, va, pa);
   }
-  release(&swap_area.lock);
-  
-  return -1;  // No free slot found
+  releasesleep(&reclaimlock);
 }
 
-// Free a swap slot
+// Bring back the pages that swapoutproc() took from the current
+// process, now that it runs again. Consecutive pages were given
+// consecutive slots, so each run is read with one disk command.
+// Stops early rather than push memory below the watermark.
 void
-freeslot(int slot_index)
+swapinproc(void)
 {
-  if(slot_index < 0 || slot_index >= 800)
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint a;
+
+  if(p->swappedout == 0)
     return;
-    
-  acquire(&swap_area.lock);
-  swap_area.slots[slot_index].is_free = 1;
-  swap_area.slots[slot_index].page_perm = 0;
-  release(&swap_area.lock);
+  p->swappedout = 0;
+  vmstat.procswapins++;
+  for(a = 0; (pte = nextpte(p->pgdir, &a, p->sz)) != 0; a += PGSIZE){
+    if(*pte & PTE_P)
+      continue;
+    if(countpages() <= threshold + SWAPRUN || swapin(p, p->pgdir, a, SWAPRUN-1, 0) < 0)
+      break;
+  }
 }
 
-// Count free pages in memory
-int
-countpages(void)
+// Record advice for [start, end) in p, replacing whatever was
+// recorded for the parts of other ranges it overlaps. MADV_NORMAL
+// only clears. Returns -1 if p has no room for another range.
+static int
+setadvice(struct proc *p, uint start, uint end, int advice)
 {
-  struct run *r;
-  int count = 0;
-  
-  extern struct {
-    struct spinlock lock;
-    int use_lock;
-    struct run *freelist;
-  } kmem;
-  
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
-  while(r) {
-    count++;
-    r = r->next;
-  }
-  if(kmem.use_lock)
-    release(&kmem.lock);
-  
-  return count;
+  struct vmadvice t[NADVISE], *v, *w;
+
+  memmove(t, p->advice, sizeof(t));
+  for(v = t; v < &t[NADVISE]; v++){
+    if(v->advice == 0 || v->end <= start || v->start >= end)
+      continue;
+    if(v->start < start && v->end > end){
+      // Split around the new range.
+      for(w = t; w < &t[NADVISE] && w->advice; w++)
+        ;
+      if(w == &t[NADVISE])
+        return -1;
+      *w = *v;
+      w->start = end;
+      v->end = start;
+    } else if(v->start < start)
+      v->end = start;
+    else if(v->end > end)
+      v->start = end;
+    else
+      v->advice = 0;
+  }
+  if(advice != MADV_NORMAL){
+    for(w = t; w < &t[NADVISE] && w->advice; w++)
+      ;
+    if(w == &t[NADVISE])
+      return -1;
+    w->start = start;
+    w->end = end;
+    w->advice = advice;
+  }
+  memmove(p->advice, t, sizeof(t));
+  return 0;
 }
 
-// Function to swap a page out to disk
-int 
-swappageout(pde_t *pgdir, uint va, uint pa) 
+// Throw away the current process's pages in [start, end) without
+// writing them anywhere. Each PTE is cleared and its frame or swap
+// copy released; the next touch gets a zeroed page from
+// demandzero(), as for fresh sbrk() memory. Pages pinned by mlock()
+// stay.
+static void
+dontneed(struct proc *p, uint start, uint end)
 {
-    int slot_index = findslot();
-    if(slot_index < 0)
-        return -1;  // No free slot available
-        
-    // Calculate the starting block number for this slot
-    uint blockno = 2 + slot_index * 8;  // 2 blocks for boot and superblock
-    
-    // Get the PTE for this virtual address
-    pte_t *pte = walkpgdir(pgdir, (void*)va, 0);
-    if(!pte || !(*pte & PTE_P))
-        return -1;  // Page not present
-        
-    // Save the page permissions
-    acquire(&swap_area.lock);
-    swap_area.slots[slot_index].page_perm = *pte & 0xFFF;  // Save the lower 12 bits (flags)
-    release(&swap_area.lock);
-    
-    // Write the page to disk
-    for(int i = 0; i < 8; i++) {
-        struct buf *b = bread(0, blockno + i);
-        memmove(b->data, (char*)(P2V(pa)) + i*BSIZE, BSIZE);
-        bwrite(b);
-        brelse(b);
+  uint a, va[SWAPBATCH], pa[SWAPBATCH];
+  pte_t *pte, old;
+  int i, n;
+
+  // Keep swapin() from mapping a page whose swap copy is dropped.
+  acquiresleep(&swapinlock);
+  a = start;
+  for(;;){
+    n = 0;
+    while(n < SWAPBATCH && (pte = nextpte(p->pgdir, &a, end)) != 0){
+      old = *pte;
+      if(old & PTE_EVICT){
+        swapwait(pte);
+        continue;
+      }
+      if(!(old & PTE_U) || ((old & PTE_P) && framelocked(PTE_ADDR(old)))){
+        a += PGSIZE;
+        continue;
+      }
+      if(cmpxchg(pte, old, 0) != old)
+        continue;  // Swapped out under us; look again
+      if(old & PTE_P){
+        va[n] = a;
+        pa[n] = PTE_ADDR(old);
+        n++;
+      } else
+        swapdrop(old);
+      a += PGSIZE;
     }
-    
-    // Update the PTE to point to the swap slot
-    // Clear the PTE_P bit and set the slot index in the PPN field
-    // Make sure to preserve the user and write permissions
-    *pte = (slot_index << 12) | ((*pte) & ~PTE_P & 0xFFF);
-    
-    // Flush the TLB
-    lcr3(V2P(pgdir));
-    
-    //cprintf("Swapped out page at VA 0x%x to slot %d\n", va, slot_index);
-    return 0;
+    if(n == 0)
+      break;
+    tlbflush(p->pgdir, va, n);
+    for(i = 0; i < n; i++){
+      p->rss--;
+      if(kunref((char*)P2V(pa[i]))){
+        framedel(pa[i], 0);
+        kfree((char*)P2V(pa[i]));
+      }
+    }
+  }
+  releasesleep(&swapinlock);
 }
 
-
-// Function to swap a page in from disk
-int
-swappage_in(pde_t *pgdir, void *va)
+// Queue [start, end) of p for kprefetch(). The hint is dropped if
+// the queue is full.
+static void
+prefetch(struct proc *p, uint start, uint end)
 {
-  // Round down to page boundary
-  uint page_addr = PGROUNDDOWN((uint)va);
-  
-  pte_t *pte = walkpgdir(pgdir, (void*)page_addr, 0);
-  if(!pte) {
-    return -1; // No PTE for this address
-  }
-  
-  if(*pte & PTE_P) {
-    return 0; // Page already present
+  acquire(&prefetchq.lock);
+  if(prefetchq.n < NPREFETCH){
+    prefetchq.q[prefetchq.n].p = p;
+    prefetchq.q[prefetchq.n].start = start;
+    prefetchq.q[prefetchq.n].end = end;
+    prefetchq.n++;
+    wakeup(&prefetchq);
   }
-  
-  // Extract the slot index from the PTE
-  int slot_index = PTE_ADDR(*pte) >> 12;
-  
-  if(slot_index < 0 || slot_index >= 800 || swap_area.slots[slot_index].is_free) {
-    return -1; // Invalid slot or slot is free
+  release(&prefetchq.lock);
+}
+
+// Forget the ranges of p queued for kprefetch() and wait until it
+// no longer reads one. Called before p's page tables shrink or go
+// away.
+void
+prefetchcancel(struct proc *p)
+{
+  int i, j;
+
+  acquire(&prefetchq.lock);
+  for(i = j = 0; i < prefetchq.n; i++)
+    if(prefetchq.q[i].p != p)
+      prefetchq.q[j++] = prefetchq.q[i];
+  prefetchq.n = j;
+  while(prefetchq.busy == p){
+    prefetchq.cancel = 1;
+    sleep(&prefetchq.busy, &prefetchq.lock);
   }
-  
-  // Allocate a new physical page
-  char *mem = kalloc();
-  if(!mem) {
-    // Out of memory - try to free up some space by swapping
-    checkAswap();
-    mem = kalloc(); // Try again
-    if(!mem) {
-      return -1; // Still out of memory
+  release(&prefetchq.lock);
+}
+
+// Prefetch daemon. Swaps in the ranges that madvise(MADV_WILLNEED)
+// queued, so that the process finds them resident instead of
+// waiting on the disk at each fault. Stops a range early rather
+// than push memory below the watermark.
+void
+kprefetch(void)
+{
+  struct proc *p;
+  pte_t *pte;
+  uint a, end;
+
+  for(;;){
+    acquire(&prefetchq.lock);
+    while(prefetchq.n == 0)
+      sleep(&prefetchq, &prefetchq.lock);
+    p = prefetchq.q[0].p;
+    a = prefetchq.q[0].start;
+    end = prefetchq.q[0].end;
+    prefetchq.n--;
+    memmove(&prefetchq.q[0], &prefetchq.q[1], prefetchq.n*sizeof(prefetchq.q[0]));
+    prefetchq.busy = p;
+    prefetchq.cancel = 0;
+    release(&prefetchq.lock);
+
+    for(; !prefetchq.cancel && (pte = nextpte(p->pgdir, &a, end)) != 0; a += PGSIZE){
+      if(*pte & PTE_P)
+        continue;
+      if(countpages() <= threshold + SWAPRUN || swapin(p, p->pgdir, a, SWAPRUN-1, 0) < 0)
+        break;
     }
+
+    acquire(&prefetchq.lock);
+    prefetchq.busy = 0;
+    wakeup(&prefetchq.busy);
+    release(&prefetchq.lock);
   }
-  
-  // Calculate the starting block number for this slot
-  uint blockno = 2 + slot_index * 8; // 2 blocks for boot and superblock
-  
-  // Read the page from disk
-  for(int i = 0; i < 8; i++) {
-    struct buf *b = bread(0, blockno + i);
-    memmove(mem + i*BSIZE, b->data, BSIZE);
-    brelse(b);
-  }
-  
-  // Restore the page permissions
-  uint perm;
-  acquire(&swap_area.lock);
-  perm = swap_area.slots[slot_index].page_perm;
-  release(&swap_area.lock);
-  
-  // Make sure PTE_P is set in the permissions
-  perm |= PTE_P;
-  
-  // Map the physical page to the virtual address
-  if(mappages(pgdir, (void*)page_addr, PGSIZE, V2P(mem), perm) < 0) {
-    kfree(mem);
+}
+
+// Advise the kernel how the current process will use its pages in
+// [addr, addr+len). MADV_RANDOM and MADV_SEQUENTIAL set the swap-in
+// readahead for the range (see swappage_in()) until MADV_NORMAL
+// clears it; MADV_WILLNEED starts swapping the range in the
+// background; MADV_DONTNEED discards its contents.
+int
+madvise(uint addr, uint len, int advice)
+{
+  struct proc *p = myproc();
+  uint end;
+
+  end = PGROUNDUP(addr + len);
+  if(addr % PGSIZE || addr + len < addr || end > PGROUNDUP(p->sz))
     return -1;
+  if(len == 0)
+    return 0;
+  switch(advice){
+  case MADV_NORMAL:
+  case MADV_RANDOM:
+  case MADV_SEQUENTIAL:
+    return setadvice(p, addr, end, advice);
+  case MADV_WILLNEED:
+    prefetch(p, addr, end);
+    return 0;
+  case MADV_DONTNEED:
+    dontneed(p, addr, end);
+    return 0;
   }
-  
-  // Free the swap slot
-  freeslot(slot_index);
-  
-  // Increment the rss count
-  struct proc *p = myproc();
-  if(p) p->rss++;
-  
-  return 0;
+  return -1;
 }
 
 
 
-// Function to find a victim process for swapping
+// Function to find a victim process for swapping. The process
+// furthest above its resident set target goes first; only when no
+// process is above target does raw RSS decide. A process that is
+// running on some CPU is only picked if there is no other one,
+// since its pages are the ones most likely to be touched next.
+// The victim comes back pinned by vmhold(); the caller vmput()s it.
 struct proc*
 findproc(void)
 {
   struct proc *p;
-  struct proc *victim = 0;
+  struct proc *victim = 0, *over = 0;
   int max_rss = 0;  // Changed from -1 to 0
   
-  extern struct {
-    struct spinlock lock;
-    struct proc proc[NPROC];
-  } ptable;
-  
   acquire(&ptable.lock);
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if(p->state == UNUSED || p->pid < 1)
+    if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE || p->pid < 1 ||
+       p->vmfrozen)
       continue;
+
+    if(p->rss > p->rsstarget && p->state != RUNNING &&
+       (over == 0 || p->rss - p->rsstarget > over->rss - over->rsstarget))
+      over = p;
     
     // Add debug output to see rss values
    // cprintf("Process %d has rss %d\n", p->pid, p->rss);
     
-    if(p->rss > max_rss || (p->rss == max_rss && victim && p->pid < victim->pid)) {
-      max_rss = p->rss;
-      victim = p;
-    }
+    if(victim && (p->state == RUNNING) != (victim->state == RUNNING)){
+      if(p->state == RUNNING || p->rss == 0)
+        continue;
+    } else if(!(p->rss > max_rss || (p->rss == max_rss && victim && p->pid < victim->pid)))
+      continue;
+    max_rss = p->rss;
+    victim = p;
   }
+  if(over)
+    victim = over;
+  if(victim && !vmhold(victim))
+    victim = 0;
   release(&ptable.lock);
   
   //if(victim)
@@ -320,108 +1391,277 @@ findproc(void)
 
 
 
-// Function to find a victim page in a process
+// Function to find a victim page in a process. The CLOCK hand
+// resumes where the last search stopped and gives each of the
+// victim's resident pages a second chance: a page with PTE_A set
+// has it cleared and is skipped. Two sweeps of the frame table are
+// enough to find a page if the process has any. The TLB is not
+// flushed when PTE_A is cleared; a stale entry only means the page
+// looks idle a little later than it really is.
 uint 
 findpage(pde_t *pgdir, uint *va_out) 
 {
-  uint i, pa;
+  struct frame *f;
   pte_t *pte;
-  
-  // First pass: look for pages with PTE_A unset
-  for(i = 0; i < KERNBASE; i += PGSIZE) {
-    pte = walkpgdir(pgdir, (void*)i, 0);
-    if(!pte || !(*pte & PTE_P) || !(*pte & PTE_U))
+  uint pa;
+  int n;
+
+  acquire(&frametable.lock);
+  for(n = 0; n < 2*NFRAMES; n++){
+    f = &frametable.frames[frametable.hand];
+    pa = frametable.hand * PGSIZE;
+    frametable.hand = (frametable.hand + 1) % NFRAMES;
+    if(!f->inuse || f->locked)
+      continue;
+    vmstat.pgscanned++;
+    pte = walkpgdir(pgdir, (void*)f->va, 0);
+    if(!pte || !(*pte & PTE_P) || !(*pte & PTE_U) || PTE_ADDR(*pte) != pa)
+      continue;  // Not one of the victim's pages
+    if(*pte & PTE_A){
+      // Atomic, so a PTE_D set by another CPU is not lost.
+      atomicand(pte, ~PTE_A);
+      if(f->ra)
+        rafinish(f, 1);
       continue;
-      
-    if(!(*pte & PTE_A)) {
-      // Found a page with PTE_P set and PTE_A unset
-      pa = PTE_ADDR(*pte);
-      *va_out = i;
-      return pa;
     }
+    *va_out = f->va;
+    release(&frametable.lock);
+    return pa;
   }
-  
-  // If no page with PTE_A unset is found, reset PTE_A for all pages and try again
-  for(i = 0; i < KERNBASE; i += PGSIZE) {
-    pte = walkpgdir(pgdir, (void*)i, 0);
-    if(!pte || !(*pte & PTE_P) || !(*pte & PTE_U))
-      continue;
-      
-    // Reset PTE_A for all pages
-    *pte &= ~PTE_A;
+  release(&frametable.lock);
+
+  return 0;  // No suitable page found
+}
+
+
+
+
+// Swap out the read-only page mapped from frame pa at va in
+// pgdir by pointing its PTE at spte's copy, the swapped-out PTE
+// of another process sharing the frame. The copy gains a reference.
+static int
+swapshared(pde_t *pgdir, uint va, uint pa, pte_t spte)
+{
+  pte_t *pte = walkpgdir(pgdir, (void*)va, 0);
+
+  if(!pte || !(*pte & PTE_P) || (*pte & PTE_W) || PTE_ADDR(*pte) != pa)
+    return -1;
+  if(spte & PTE_Z)
+    zdup(PTE_ADDR(spte) >> 12);
+  else if(duplicateslot(PTE_ADDR(spte) >> 12) < 0)
+    return -1;
+  xchg(pte, PTE_ADDR(spte) | (spte & PTE_Z) | (*pte & 0xFFF & ~(PTE_P|PTE_A|PTE_D)));
+  tlbflush(pgdir, &va, 1);
+  return 0;
+}
+
+// Drop the victim's reference to frame pa, now swapped out at va.
+// A frame shared copy-on-write is still mapped at va by the other
+// processes forked from the same parent; they are pointed at the
+// victim's swapped copy too so that the frame can be freed.
+// Returns 1 if it was.
+static int
+releaseframe(pde_t *pgdir, uint va, uint pa)
+{
+  struct proc *p, *sharers[NPROC];
+  pte_t *pte, spte;
+  int i, n, freed;
+
+  if(!kunref((char*)P2V(pa))){
+    // Pin the sharers' page tables; one whose process is exiting
+    // or exec'ing keeps its reference until that frees it.
+    n = 0;
+    acquire(&ptable.lock);
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+      if(p->pgdir == pgdir || p->vmfrozen || p->state == UNUSED ||
+         p->state == EMBRYO || p->state == ZOMBIE)
+        continue;
+      pte = walkpgdir(p->pgdir, (void*)va, 0);
+      if(pte && (*pte & PTE_P) && PTE_ADDR(*pte) == pa && vmhold(p))
+        sharers[n++] = p;
+    }
+    release(&ptable.lock);
+    pte = walkpgdir(pgdir, (void*)va, 0);
+    spte = pte ? *pte : 0;
+    freed = 0;
+    for(i = 0; i < n && !freed; i++){
+      if((spte & PTE_P) || spte == 0 ||
+         swapshared(sharers[i]->pgdir, va, pa, spte) < 0)
+        if(swappageout(sharers[i]->pgdir, va, pa) < 0)
+          break;
+      sharers[i]->rss--;
+      freed = kunref((char*)P2V(pa));
+    }
+    for(i = 0; i < n; i++)
+      vmput(sharers[i]);
+    if(!freed)
+      return 0;  // Still mapped by a zombie, or a sharer exited
   }
-  
-  // Flush TLB after modifying page table entries
-  lcr3(V2P(pgdir));
-  
-  // Second pass: now all pages have PTE_A unset, so pick the first one
-  for(i = 0; i < KERNBASE; i += PGSIZE) {
-    pte = walkpgdir(pgdir, (void*)i, 0);
-    if(!pte || !(*pte & PTE_P) || !(*pte & PTE_U))
+  framedel(pa, 0);
+  kfree((char*)P2V(pa));
+  vmstat.pgreclaimed++;
+  return 1;
+}
+
+// Return the process that has been asleep longest, if that is at
+// least SWAPIDLE ticks or it is suspended by load control, and it
+// still has pages in memory. It comes back pinned by vmhold().
+static struct proc*
+findidle(void)
+{
+  struct proc *p, *idle = 0;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state != SLEEPING || p->pid < 1 || p->rss == 0 || p->swappedout ||
+       p->vmfrozen)
       continue;
-      
-    // Found a page with PTE_P set (PTE_A is now unset for all pages)
-    pa = PTE_ADDR(*pte);
-    *va_out = i;
-    return pa;
+    if((p->suspended || ticks - p->sleeptick >= SWAPIDLE) &&
+       (idle == 0 || p->sleeptick < idle->sleeptick))
+      idle = p;
   }
-  
-  return 0;  // No suitable page found (should not reach here)
+  if(idle && !vmhold(idle))
+    idle = 0;
+  release(&ptable.lock);
+  return idle;
 }
 
+// Swap out the whole resident set of p, a process that has been
+// asleep for a long time. Its pages go out in address order, so
+// clusterslot() puts them in consecutive slots and swapinproc() can
+// read them back in long runs when it wakes up. The kernel stack
+// and page tables stay: p sleeps on its kernel stack, and the swap
+// code walks the page tables. Returns the number of pages freed.
+static int
+swapoutproc(struct proc *p)
+{
+  uint a, va[SWAPBATCH], pa[SWAPBATCH];
+  pte_t *pte, old[SWAPBATCH];
+  int i, n, swapped;
 
+  swapped = 0;
+  a = 0;
+  for(;;){
+    n = 0;
+    while(n < SWAPBATCH && (pte = nextpte(p->pgdir, &a, p->sz)) != 0){
+      if((*pte & (PTE_P|PTE_U)) == (PTE_P|PTE_U)){
+        va[n] = a;
+        pa[n] = PTE_ADDR(*pte);
+        if(swapunmap(p->pgdir, va[n], pa[n], &old[n]) == 0)
+          n++;
+      }
+      a += PGSIZE;
+    }
+    if(n == 0)
+      break;
+    tlbflush(p->pgdir, va, n);
+    for(i = 0; i < n; i++){
+      if(swapstore(p->pgdir, va[i], pa[i], old[i]) < 0)
+        continue;  // Swap is full; the page stays
+      p->rss--;
+      p->swappedout++;
+      if(releaseframe(p->pgdir, va[i], pa[i]))
+        swapped++;
+    }
+  }
+  vmstat.procswapouts++;
+  return swapped;
+}
 
-
-// Function to swap out pages based on the adaptive policy
-void 
+// Function to swap out pages based on the adaptive policy. A
+// process that has slept for SWAPIDLE ticks loses all its pages at
+// once; otherwise up to npages_to_swap pages are taken from the
+// process findproc() picks. Returns the number of pages swapped
+// out. Caller must hold reclaimlock.
+int
 swapout(void) 
 {
-  struct proc *victim = findproc();
+  struct proc *victim;
+  int swapped;
+
+  if(swapfreeslots() == 0 && frametable.ncached == 0)
+    return 0;  // Swap is full; nothing can be evicted
+  if((victim = findidle()) != 0){
+    swapped = swapoutproc(victim);
+    vmput(victim);
+    return swapped;
+  }
+  victim = findproc();
   if(!victim) {
    // cprintf("No victim process found for swapping\n");
-    return;
+    return 0;
   }
   
  // cprintf("Selected victim process %d with %d pages\n", victim->pid, victim->rss);
   
-  int swapped = 0;
+  swapped = 0;
   int attempts = 0;
-  while(swapped < npages_to_swap && attempts < npages_to_swap * 2) {
-    uint va;
-    uint pa = findpage(victim->pgdir, &va);
-    if(pa == 0) {
-    //  cprintf("No suitable page found for swapping\n");
-      break;  // No suitable page found
+  int i, n;
+  uint va[SWAPBATCH], pa[SWAPBATCH];
+  pte_t old[SWAPBATCH];
+
+  // A process above its resident set target is only trimmed to it.
+  int want = npages_to_swap;
+  if(victim->rss > victim->rsstarget && victim->rss - victim->rsstarget < want)
+    want = victim->rss - victim->rsstarget;
+
+  while(swapped < want && attempts < want * 2) {
+    // Unmap a batch of pages, flush them from every TLB with a
+    // single shootdown, then store them.
+    n = 0;
+    while(n < SWAPBATCH && swapped + n < want &&
+          attempts < want * 2) {
+      attempts++;
+      pa[n] = findpage(victim->pgdir, &va[n]);
+      if(pa[n] == 0) {
+      //  cprintf("No suitable page found for swapping\n");
+        break;  // No suitable page found
+      }
+      if(swapunmap(victim->pgdir, va[n], pa[n], &old[n]) == 0)
+        n++;
     }
-    
-    if(swappageout(victim->pgdir, va, pa) == 0) {
-      // Successfully swapped out the page
-      victim->rss--;
-      kfree((char*)P2V(pa));  // Free the physical page
-      swapped++;
-     // cprintf("Swapped out page at VA 0x%x, PA 0x%x\n", va, pa);
-    } else {
-    //  cprintf("Failed to swap out page at VA 0x%x, PA 0x%x\n", va, pa);
+    if(n == 0)
+      break;
+    tlbflush(victim->pgdir, va, n);
+
+    for(i = 0; i < n; i++) {
+      if(swapstore(victim->pgdir, va[i], pa[i], old[i]) == 0) {
+        // Successfully swapped out the page
+        victim->rss--;
+        if(releaseframe(victim->pgdir, va[i], pa[i]))  // Free the physical page
+          swapped++;
+      }
     }
-    attempts++;
   }
   
  // cprintf("Swapped %d pages after %d attempts\n", swapped, attempts);
+  vmput(victim);
+  return swapped;
 }
 
 
-// Adaptive page replacement function
-void
+// Adaptive page replacement function, run by kswapd. Once free
+// memory drops to the low watermark (threshold), evict batches of
+// npages_to_swap until the high watermark (threshold plus one batch)
+// is reached, then adapt the watermark and batch size. Returns the
+// number of pages swapped out.
+int
 checkAswap(void)
 {
   int free_pages = countpages();
+  int high, swapped = 0, n;
   
   if(free_pages <= threshold) {
     cprintf("Current Threshold = %d, Swapping %d pages\n", 
             threshold, npages_to_swap);
     
-    // Swap out npages_to_swap pages
-    swapout();
+    // Swap out batches of npages_to_swap pages
+    high = threshold + npages_to_swap;
+    vmstat.kswapdruns++;
+    acquiresleep(&reclaimlock);
+    while(countpages() < high && (n = swapout()) > 0)
+      swapped += n;
+    releasesleep(&reclaimlock);
     
     threshold -= (threshold * beta) / 100;
     if(threshold < 1) threshold = 1;  // Ensure threshold doesn't go below 1
@@ -430,30 +1670,198 @@ checkAswap(void)
     if(npages_to_swap > limit)
       npages_to_swap = limit;
   }
+  return swapped;
+}
+
+// Called on every clock tick. While free memory stays above the
+// high watermark, step threshold and npages_to_swap back toward
+// their base values, at the rate checkAswap() moves them away, so
+// that one burst of pressure does not distort reclaim for good.
+void
+swaprelax(void)
+{
+  int step;
+
+  if(ticks % RELAXTICKS != 0 || countpages() <= threshold + npages_to_swap)
+    return;
+  if(threshold < basethreshold){
+    step = (threshold * beta) / 100;
+    threshold += step > 0 ? step : 1;
+    if(threshold > basethreshold)
+      threshold = basethreshold;
+  }
+  if(npages_to_swap > basenpages){
+    step = (npages_to_swap * alpha) / 100;
+    npages_to_swap -= step > 0 ? step : 1;
+    if(npages_to_swap < basenpages)
+      npages_to_swap = basenpages;
+  }
+}
+
+// Fill in a snapshot of the memory and swap statistics.
+void
+getvmstat(struct vmstat *st)
+{
+  struct zswapstat zs;
+  int reserved;
+
+  *st = vmstat;
+  st->ticks = ticks;
+  kmemstat(&st->totalpages, &st->freepages, &reserved);
+  st->swapslots = swap_area.nslots;
+  st->swapused = swap_area.nslots - swapfreeslots();
+  zswapstat(&zs);
+  st->zstored = zs.stored + zs.samefilled;
+  st->zpoolpages = zs.poolpages;
+  st->threshold = threshold;
+}
+
+// Copy the swap policy parameters to sp, after setting them from
+// sp if set is non-zero. Returns -1 if the new values are invalid.
+int
+swapctl(struct swapparams *sp, int set)
+{
+  acquire(&swap_area.lock);
+  if(set){
+    if(sp->threshold < 1 || sp->basethreshold < 1 || sp->limit < 1 ||
+       sp->npages_to_swap < 1 || sp->npages_to_swap > sp->limit ||
+       sp->basenpages < 1 || sp->basenpages > sp->limit ||
+       sp->alpha < 0 || sp->alpha > 100 || sp->beta < 0 || sp->beta > 100){
+      release(&swap_area.lock);
+      return -1;
+    }
+    threshold = sp->threshold;
+    npages_to_swap = sp->npages_to_swap;
+    alpha = sp->alpha;
+    beta = sp->beta;
+    limit = sp->limit;
+    basethreshold = sp->basethreshold;
+    basenpages = sp->basenpages;
+  }
+  sp->threshold = threshold;
+  sp->npages_to_swap = npages_to_swap;
+  sp->alpha = alpha;
+  sp->beta = beta;
+  sp->limit = limit;
+  sp->basethreshold = basethreshold;
+  sp->basenpages = basenpages;
+  release(&swap_area.lock);
+  return 0;
+}
+
+// May the caller sleep? Not while it holds a spinlock. Interrupts
+// being off is no answer: page faults come in through an interrupt
+// gate with interrupts off, and they sleep for swap I/O anyway.
+static int
+cansleep(void)
+{
+  int ncli;
+
+  pushcli();
+  ncli = mycpu()->ncli;
+  popcli();
+  return ncli == 1;
+}
+
+// Synchronous reclaim for kalloc() when the free list is empty.
+// Only evicts one batch; background reclaim is kswapd's job. If
+// that frees nothing, memory and swap are exhausted and the OOM
+// killer picks a process to kill. Skipped when the caller cannot
+// sleep or is already reclaiming (the swap path itself
+// allocating). Returns 1 if pages were freed, by reclaim or by an
+// OOM victim exiting, and kalloc() should look again; 0 if it
+// should fail.
+int
+directreclaim(void)
+{
+  int n;
+
+  if(myproc() == 0 || !cansleep() || holdingsleep(&reclaimlock))
+    return 0;
+  acquiresleep(&reclaimlock);
+  vmstat.directreclaims++;
+  n = swapout();
+  releasesleep(&reclaimlock);
+  if(n > 0 || kfreepage() > 0)
+    return 1;
+  return oomkill();
+}
+
+// Called by kalloc() with the free page count after each
+// allocation; wakes kswapd once the low watermark is reached.
+// kswapd_sleeping is tested under swap_area.lock, which kswapd
+// holds from its free page check until sleep(), so the wakeup
+// cannot fall between the two. kalloc() is never called with
+// swap_area.lock held.
+void
+kswapdwakeup(int free_pages)
+{
+  if(free_pages > threshold)
+    return;
+  acquire(&swap_area.lock);
+  if(kswapd_sleeping)
+    wakeup(&kswapd_sleeping);
+  release(&swap_area.lock);
+}
+
+// Swap daemon. Sleeps until kalloc() reports that free memory fell
+// to the low watermark and then reclaims in the background, so
+// allocating processes do not wait for disk writes. If a pass frees
+// nothing (swap full, nothing evictable) it backs off for
+// KSWAPD_BACKOFF ticks instead of retrying at once.
+void
+kswapd(void)
+{
+  uint ticks0;
+
+  for(;;){
+    acquire(&swap_area.lock);
+    while(countpages() > threshold){
+      kswapd_sleeping = 1;
+      sleep(&kswapd_sleeping, &swap_area.lock);
+      kswapd_sleeping = 0;
+    }
+    release(&swap_area.lock);
+    if(checkAswap() > 0)
+      continue;
+    acquire(&tickslock);
+    ticks0 = ticks;
+    while(ticks - ticks0 < KSWAPD_BACKOFF)
+      sleep(&ticks, &tickslock);
+    release(&tickslock);
+  }
 }
 
 
-// Clean up swap slots for a process when it exits
+// Drop the reference a swapped-out PTE holds on its swap slot or
+// compressed pool entry.
+void
+swapdrop(pte_t pte)
+{
+  if(pte & PTE_Z)
+    zfree(PTE_ADDR(pte) >> 12);
+  else if(!(pte & PTE_P) && pte != 0)
+    freeslot(PTE_ADDR(pte) >> 12);
+}
+
+// Drop a process's references to swap slots and pool entries when
+// it exits; copies shared with a forked process stay behind. The
+// PTEs are cleared so that freevm() does not drop them again.
 void
 swapFree(struct proc *p)
 {
   pte_t *pte;
-  uint i;
-  
+  uint va;
+
   if(!p || !p->pgdir)
     return;
-  
-  for(i = 0; i < KERNBASE; i += PGSIZE) {
-    pte = walkpgdir(p->pgdir, (void*)i, 0);
-    if(!pte)
-      continue;
-    
-    if(!(*pte & PTE_P) && (*pte != 0)) {
-      // This is a swapped-out page
-      int slot_index = PTE_ADDR(*pte) >> 12;
-      if(slot_index >= 0 && slot_index < 800) {
-        freeslot(slot_index);
-      }
+
+  for(va = 0; (pte = nextpte(p->pgdir, &va, KERNBASE)) != 0; va += PGSIZE){
+    if(*pte & PTE_EVICT)
+      swapwait(pte);
+    if(!(*pte & PTE_P)){
+      swapdrop(*pte);
+      *pte = 0;
     }
   }
 }
@@ -11,4 +11,16 @@
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       20985  // size of file system in blocks
+#define NSWAPSLOTS   2048  // max page-sized swap slots over all swap devices
+#define NSWAPDEV     4  // max swap devices
+#define FSSWAPSLOTS  800  // slots in the swap area mkfs reserves on the root disk
+#define BOOTSWAPSTART 2048  // first swap block on the boot disk, past the kernel
+#define BOOTSWAPSLOTS 960  // swap slots on the boot disk
+#define SWAPMAPWORDS ((NSWAPSLOTS+31)/32)  // words in swap slot bitmap
+#define SWAPRUN      8  // max pages moved by one swap I/O
+#define ZPOOLPAGES   64  // max pages used by the compressed swap pool
+#define NZENTRY      1024  // max pages held in the compressed swap pool
+#define MLOCKPAGES   64  // default per-process limit on pages pinned by mlock()
+#define MLOCKSHARE   4  // no process may pin more than 1/MLOCKSHARE of memory
+#define NADVISE      8  // madvise() ranges remembered per process
 
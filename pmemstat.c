@@ -0,0 +1,33 @@
+// Print each process's resident set, the target the page fault
+// frequency policy has set for it, and its recent page-in rate.
+// Reclaim trims processes above their target first.
+//   pmemstat
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pmemstat.h"
+
+struct pmemstat st[NPROC];
+
+int
+main(int argc, char *argv[])
+{
+  int i, n;
+
+  if(argc != 1){
+    printf(2, "usage: pmemstat\n");
+    exit();
+  }
+  if((n = pmemstat(st, NPROC)) < 0){
+    printf(2, "pmemstat: failed\n");
+    exit();
+  }
+  printf(1, "pid name rss locked target rate/%d ticks\n", n > 0 ? st[0].window : 0);
+  for(i = 0; i < n; i++)
+    printf(1, "%d %s %d %d %d%s %d %d\n", st[i].pid, st[i].name, st[i].rss,
+           st[i].locked, st[i].target, st[i].rss > st[i].target ? "*" : "",
+           st[i].rate, st[i].cputicks);
+  exit();
+}
@@ -0,0 +1,12 @@
+// Per-process memory state returned by pmemstat(), one entry per
+// process.
+struct pmemstat {
+  int pid;
+  char name[16];
+  uint rss;             // Resident pages
+  uint locked;          // Of those, pages pinned by mlock()
+  uint target;          // Resident set target set by the fault rate
+  uint rate;            // Page-ins in its last window of CPU ticks
+  uint window;          // Window length in CPU ticks
+  uint cputicks;        // Clock ticks it has run for
+};
@@ -6,12 +6,34 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "zswap.h"
+#include "vmstat.h"
+#include "loadstat.h"
+#include "pmemstat.h"
+#include "memlimit.h"
+
+#define THRASHWINDOW 100  // Ticks over which the swap-in rate is measured
+#define THRASHHIGH   256  // Swap-ins per window that mean thrashing
+#define THRASHLOW    32   // Swap-ins per window low enough to readmit
+
+#define PFFWINDOW    10   // CPU ticks over which a process's page-in rate is measured
+#define PFFHIGH      4    // Page-ins per window that grow the resident set target
+#define PFFMIN       16   // Smallest resident set target, in pages
+
+#define OOMWAIT      100  // Ticks an allocation waits for an OOM victim to die
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
 } ptable;
 
+// Load control state, protected by ptable.lock.
+static struct {
+  int thrashing;
+  uint rate;
+  uint lastswapins;
+} load;
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -23,7 +45,15 @@ extern void swapFree(struct proc*);
 
 void printpage(void){
     struct proc* p;
+    int total, free, reserved;
+    struct zswapstat zs;
     cprintf("Ctrl+I is detected by xv6\n");
+    kmemstat(&total, &free, &reserved);
+    cprintf("TOTAL %d FREE %d RESERVED %d\n", total, free, reserved);
+    zswapstat(&zs);
+    cprintf("ZSWAP STORED %d POOL %d BYTES %d REJECTED %d FULL %d\n",
+            zs.stored, zs.poolpages, zs.bytes, zs.rejected, zs.full);
+    cprintf("SAMEFILLED %d ELIDED %d\n", zs.samefilled, zs.elided);
     cprintf("PID NUM_PAGES\n");
     acquire(&ptable.lock);
     for(p = ptable.proc ; p < &ptable.proc[NPROC]; p++){
@@ -35,6 +65,26 @@ void printpage(void){
     }
     release(&ptable.lock);
 }
+// Copy the pids and fault counts of the n process table slots
+// starting at slot, and clear the counts if reset is set.
+void
+procfltstat(int slot, int n, int *pid, uint *majflt, uint *minflt, int reset)
+{
+  struct proc *p;
+  int i;
+
+  acquire(&ptable.lock);
+  for(i = 0; i < n; i++){
+    p = &ptable.proc[slot+i];
+    pid[i] = p->state == UNUSED ? 0 : p->pid;
+    majflt[i] = p->majflt;
+    minflt[i] = p->minflt;
+    if(reset)
+      p->majflt = p->minflt = 0;
+  }
+  release(&ptable.lock);
+}
+
 void
 pinit(void)
 {
@@ -104,6 +154,23 @@ found:
   p->state = EMBRYO;
   p->pid = nextpid++;
   p->rss = 0;
+  p->majflt = 0;
+  p->minflt = 0;
+  p->swappedout = 0;
+  p->suspended = 0;
+  p->rsstarget = PFFMIN;
+  p->pffflt = 0;
+  p->pffrate = 0;
+  p->cputicks = 0;
+  p->rsslimit = 0;
+  p->swaplimit = 0;
+  p->oomadj = 0;
+  p->oomkilled = 0;
+  p->mlocked = 0;
+  p->mlocklimit = MLOCKPAGES;
+  memset(p->advice, 0, sizeof(p->advice));
+  p->vmref = 0;
+  p->vmfrozen = 0;
 
   release(&ptable.lock);
 
@@ -169,6 +236,29 @@ userinit(void)
   release(&ptable.lock);
 }
 
+// Create a kernel thread that runs fn, which must never return.
+// It has a kernel-only page table and never enters user space.
+struct proc*
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    return 0;
+  if((p->pgdir = setupkvm()) == 0)
+    panic("kthread: out of memory?");
+  p->sz = 0;
+  // Have forkret return into fn rather than trapret.
+  *(uint*)((char*)p->context + sizeof(*p->context)) = (uint)fn;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+
+  return p;
+}
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -179,22 +269,27 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // With both limits set, the process can never use more than
+    // their sum.
+    if(curproc->rsslimit && curproc->swaplimit &&
+       PGROUNDUP(sz + n) / PGSIZE > curproc->rsslimit + curproc->swaplimit)
       return -1;
-    curproc->rss += n / PGSIZE;
-    if(n% PGSIZE != 0){
-        curproc->rss++;
-    }
+    // Only reserve the address space. The page fault handler gives
+    // each page a zeroed frame when it is first touched.
+    if(sz + n < sz || sz + n >= KERNBASE)
+      return -1;
+    sz += n;
   } else if(n < 0){
+    prefetchcancel(curproc);
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
-    curproc->rss -= (-n) / PGSIZE;
-    if((-n) % PGSIZE != 0){
-        curproc->rss++;
-    }
   }
   curproc->sz = sz;
+  curproc->rss = residentpages(curproc->pgdir, sz);
+  if(n < 0)
+    curproc->mlocked = lockedpages(curproc->pgdir, sz);
   switchuvm(curproc);
+  rsstrim();
   return 0;
 }
 
@@ -223,7 +318,13 @@ fork(void)
   np->sz = curproc->sz;
   np->parent = curproc;
   *np->tf = *curproc->tf;
-  np->rss = curproc->rss;
+  np->rss = residentpages(np->pgdir, np->sz);
+  np->rsstarget = curproc->rsstarget;
+  np->rsslimit = curproc->rsslimit;
+  np->swaplimit = curproc->swaplimit;
+  np->oomadj = curproc->oomadj;
+  np->mlocklimit = curproc->mlocklimit;
+  memmove(np->advice, curproc->advice, sizeof(np->advice));
 
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
@@ -272,6 +373,11 @@ exit(void)
   end_op();
   curproc->cwd = 0;
 
+  // Release swap space now; this may wait for pages being swapped out.
+  prefetchcancel(curproc);
+  vmquiesce(curproc);
+  swapFree(curproc);
+
   acquire(&ptable.lock);
 
   // Parent might be sleeping in wait().
@@ -285,7 +391,6 @@ exit(void)
         wakeup1(initproc);
     }
   }
-  swapFree(curproc);
 
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
@@ -300,6 +405,7 @@ wait(void)
 {
   struct proc *p;
   int havekids, pid;
+  pde_t *pgdir;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
@@ -315,13 +421,16 @@ wait(void)
         pid = p->pid;
         kfree(p->kstack);
         p->kstack = 0;
-        freevm(p->pgdir);
+        pgdir = p->pgdir;
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
         p->state = UNUSED;
         release(&ptable.lock);
+        // Outside ptable.lock: freevm() may have to wait for
+        // pages that kswapd is swapping out.
+        freevm(pgdir);
         return pid;
       }
     }
@@ -433,6 +542,7 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    swapdevinit();
   }
 
   // Return to "caller", actually trapret (see allocproc).
@@ -464,6 +574,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sleeptick = ticks;
 
   sched();
 
@@ -522,6 +633,282 @@ kill(int pid)
   return -1;
 }
 
+// Load control, run on every clock tick. Once per THRASHWINDOW
+// ticks it compares the number of pages swapped in during the
+// window with THRASHHIGH. While the system is thrashing, one more
+// process is suspended each window: the one with the largest
+// resident set, as long as another user process is left running,
+// so that the rest fit in memory. Once the rate falls to THRASHLOW
+// the process suspended longest is readmitted, one per window.
+void
+loadctl(void)
+{
+  struct proc *p, *q;
+  int active;
+
+  if(ticks % THRASHWINDOW != 0)
+    return;
+  acquire(&ptable.lock);
+  load.rate = vmstat.swapins - load.lastswapins;
+  load.lastswapins = vmstat.swapins;
+  if(load.rate >= THRASHHIGH)
+    load.thrashing = 1;
+  else if(load.rate <= THRASHLOW)
+    load.thrashing = 0;
+
+  q = 0;
+  if(load.thrashing){
+    active = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+      if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE ||
+         p == initproc || p->sz == 0 || p->suspended || p->killed)
+        continue;
+      active++;
+      if(q == 0 || p->rss > q->rss)
+        q = p;
+    }
+    if(active > 1){
+      q->suspended = 1;
+      q->suspendtick = ticks;
+      cprintf("loadctl: %d swap-ins in %d ticks, suspend pid %d rss %d\n",
+              load.rate, THRASHWINDOW, q->pid, q->rss);
+    }
+  } else if(load.rate <= THRASHLOW){
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+      if(p->suspended && (q == 0 || p->suspendtick < q->suspendtick))
+        q = p;
+    if(q){
+      q->suspended = 0;
+      wakeup1(&q->suspended);
+    }
+  }
+  release(&ptable.lock);
+}
+
+// Called on the way back to user space: a process suspended by
+// loadctl() waits here, holding no locks, until it is readmitted
+// or killed.
+void
+loadwait(void)
+{
+  struct proc *p = myproc();
+
+  if(!p->suspended)
+    return;
+  acquire(&ptable.lock);
+  while(p->suspended && !p->killed)
+    sleep(&p->suspended, &ptable.lock);
+  p->suspended = 0;
+  release(&ptable.lock);
+}
+
+// Fill in the load control state.
+void
+loadstat(struct loadstat *st)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  st->thrashing = load.thrashing;
+  st->rate = load.rate;
+  st->window = THRASHWINDOW;
+  st->high = THRASHHIGH;
+  st->low = THRASHLOW;
+  st->nsuspended = 0;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state != UNUSED && p->suspended)
+      st->suspended[st->nsuspended++] = p->pid;
+  release(&ptable.lock);
+}
+
+// Page-fault-frequency resident set sizing, run on each clock tick
+// for the process running on this CPU. Every PFFWINDOW ticks of CPU
+// time, a process that paged in PFFHIGH or more pages is given room
+// for its current resident set plus those pages; one that paged in
+// nothing has its target cut by an eighth. Reclaim takes pages from
+// processes above their target first.
+void
+pfftick(void)
+{
+  struct proc *p = myproc();
+  int total, free, reserved;
+
+  if(p == 0 || p->state != RUNNING || ++p->cputicks % PFFWINDOW != 0)
+    return;
+  p->pffrate = p->pffflt;
+  p->pffflt = 0;
+  if(p->pffrate >= PFFHIGH){
+    if(p->rsstarget < p->rss)
+      p->rsstarget = p->rss;
+    p->rsstarget += p->pffrate;
+    kmemstat(&total, &free, &reserved);
+    if(p->rsstarget > total)
+      p->rsstarget = total;
+  } else if(p->pffrate == 0)
+    p->rsstarget -= p->rsstarget / 8;
+  if(p->rsstarget < PFFMIN)
+    p->rsstarget = PFFMIN;
+}
+
+// Fill in st with the memory state of the process in slot i of the
+// process table. Returns 0, or -1 if the slot is not in use.
+int
+pmemstat(int i, struct pmemstat *st)
+{
+  struct proc *p = &ptable.proc[i];
+  int r = -1;
+
+  acquire(&ptable.lock);
+  if(p->state != UNUSED && p->state != EMBRYO){
+    st->pid = p->pid;
+    safestrcpy(st->name, p->name, sizeof(st->name));
+    st->rss = p->rss;
+    st->locked = p->mlocked;
+    st->target = p->rsstarget;
+    st->rate = p->pffrate;
+    st->window = PFFWINDOW;
+    st->cputicks = p->cputicks;
+    r = 0;
+  }
+  release(&ptable.lock);
+  return r;
+}
+
+// Read the memory limits of process pid into ml, after setting them
+// from ml if set is non-zero. A process may only set its own limits
+// and those of its children, so it cannot aim the OOM killer or
+// rsstrim at an unrelated process. The mlock limit is cut down to
+// 1/MLOCKSHARE of memory, so that pinned pages cannot starve
+// reclaim.
+int
+memlimit(int pid, struct memlimit *ml, int set)
+{
+  struct proc *curproc = myproc();
+  struct proc *p;
+  int total, nfree, reserved;
+
+  if(set && (ml->rss < 0 || ml->swap < 0 || ml->mlock < 0))
+    return -1;
+  kmemstat(&total, &nfree, &reserved);
+  if(set && ml->mlock > total/MLOCKSHARE)
+    ml->mlock = total/MLOCKSHARE;
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid != pid || p->state == UNUSED)
+      continue;
+    if(set && p != curproc && p->parent != curproc)
+      break;
+    if(set){
+      p->rsslimit = ml->rss;
+      p->swaplimit = ml->swap;
+      p->oomadj = ml->oomadj;
+      p->mlocklimit = ml->mlock;
+    }
+    ml->rss = p->rsslimit;
+    ml->swap = p->swaplimit;
+    ml->oomadj = p->oomadj;
+    ml->mlock = p->mlocklimit;
+    release(&ptable.lock);
+    return 0;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+// Pin p's address space for a reclaimer, which walks and edits its
+// page table after dropping ptable.lock. Caller must hold
+// ptable.lock. Returns 0 if the page table is going away.
+int
+vmhold(struct proc *p)
+{
+  if(!holding(&ptable.lock))
+    panic("vmhold");
+  if(p->vmfrozen || p->state == UNUSED || p->state == EMBRYO ||
+     p->state == ZOMBIE)
+    return 0;
+  p->vmref++;
+  return 1;
+}
+
+// Release a pin taken by vmhold().
+void
+vmput(struct proc *p)
+{
+  acquire(&ptable.lock);
+  if(--p->vmref == 0)
+    wakeup(&p->vmref);
+  release(&ptable.lock);
+}
+
+// Keep reclaimers away from p's page table, waiting for the ones
+// using it, before exec replaces it or exit frees it.
+void
+vmquiesce(struct proc *p)
+{
+  acquire(&ptable.lock);
+  p->vmfrozen = 1;
+  while(p->vmref > 0)
+    sleep(&p->vmref, &ptable.lock);
+  release(&ptable.lock);
+}
+
+// Out of memory: reclaim freed nothing and there is no free page.
+// Kill the user process with the highest badness, its resident plus
+// swapped-out pages plus its oomadj, instead of failing whichever
+// process happened to allocate. Init, kernel threads and processes
+// with oomadj OOM_DISABLE are never picked. While an earlier victim
+// is still dying nobody else is killed; the caller waits up to
+// OOMWAIT ticks for memory to come back. Returns 1 if it did, so
+// that the allocation can be tried again.
+int
+oomkill(void)
+{
+  struct proc *p, *victim;
+  int badness, best, swapped, vswapped;
+  uint ticks0;
+
+  acquire(&ptable.lock);
+  victim = 0;
+  best = vswapped = 0;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->oomkilled && p->state != UNUSED && p->state != ZOMBIE){
+      victim = 0;  // Still waiting for the last one to exit
+      break;
+    }
+    if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE ||
+       p == initproc || p->sz == 0 || p->killed || p->oomadj == OOM_DISABLE)
+      continue;
+    // An exec in progress may be freeing the old page table.
+    swapped = p->vmfrozen ? 0 : swappedpages(p->pgdir, p->sz);
+    badness = p->rss + swapped + p->oomadj;
+    if(victim == 0 || badness > best){
+      victim = p;
+      best = badness;
+      vswapped = swapped;
+    }
+  }
+  if(victim){
+    cprintf("oom: out of memory (free %d, swap free %d); killing pid %d %s,"
+            " badness %d = rss %d + swap %d + adj %d\n",
+            kfreepage(), swapfreeslots(), victim->pid, victim->name,
+            best, victim->rss, vswapped, victim->oomadj);
+    victim->killed = 1;
+    victim->oomkilled = 1;
+    if(victim->state == SLEEPING)
+      victim->state = RUNNABLE;
+  }
+  release(&ptable.lock);
+  if(victim == myproc())
+    return 0;
+
+  acquire(&tickslock);
+  ticks0 = ticks;
+  while(kfreepage() == 0 && ticks - ticks0 < OOMWAIT && !myproc()->killed)
+    sleep(&ticks, &tickslock);
+  release(&tickslock);
+  return kfreepage() > 0;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
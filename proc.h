@@ -34,6 +34,13 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// An address range with an madvise() access pattern hint.
+struct vmadvice {
+  uint start;                  // Page-aligned range [start, end)
+  uint end;
+  int advice;                  // MADV_RANDOM or MADV_SEQUENTIAL, 0 if unused
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -50,6 +57,25 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
   uint rss;
+  uint majflt;                 // Page faults that read the swap disk
+  uint minflt;                 // Page faults resolved without I/O
+  uint sleeptick;              // ticks when it last went to sleep
+  int swappedout;              // Pages taken by a whole-process swap-out
+  int suspended;               // Held back by load control
+  uint suspendtick;            // ticks when it was suspended
+  uint rsstarget;              // Resident set target, in pages
+  uint pffflt;                 // Page-ins in the current window
+  uint pffrate;                // Page-ins in the last window
+  uint cputicks;               // Clock ticks spent running
+  int rsslimit;                // Most resident pages, 0 if unlimited
+  int swaplimit;               // Most swapped-out pages, 0 if unlimited
+  int oomadj;                  // Added to the OOM badness score
+  int oomkilled;               // Killed by the OOM killer
+  int mlocked;                 // Pages pinned by mlock()
+  int mlocklimit;              // Most pages it may pin
+  struct vmadvice advice[NADVISE]; // Access pattern hints
+  int vmref;                   // Reclaimers using pgdir (see vmhold)
+  int vmfrozen;                // pgdir is about to be replaced or freed
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -0,0 +1,52 @@
+// Show or change the adaptive swap policy.
+//   swapctl                       print the parameters
+//   swapctl name value ...        set them; name is threshold,
+//                                 npages, alpha, beta or limit
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "swapctl.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct swapparams sp;
+  int i, v;
+
+  if(argc % 2 == 0){
+    printf(2, "usage: swapctl [threshold|npages|alpha|beta|limit value]...\n");
+    exit();
+  }
+  if(swapctl(&sp, 0) < 0){
+    printf(2, "swapctl: cannot read parameters\n");
+    exit();
+  }
+  if(argc > 1){
+    for(i = 1; i < argc; i += 2){
+      v = atoi(argv[i+1]);
+      if(strcmp(argv[i], "threshold") == 0)
+        sp.threshold = sp.basethreshold = v;
+      else if(strcmp(argv[i], "npages") == 0)
+        sp.npages_to_swap = sp.basenpages = v;
+      else if(strcmp(argv[i], "alpha") == 0)
+        sp.alpha = v;
+      else if(strcmp(argv[i], "beta") == 0)
+        sp.beta = v;
+      else if(strcmp(argv[i], "limit") == 0)
+        sp.limit = v;
+      else {
+        printf(2, "swapctl: unknown parameter %s\n", argv[i]);
+        exit();
+      }
+    }
+    if(swapctl(&sp, 1) < 0){
+      printf(2, "swapctl: invalid parameters\n");
+      exit();
+    }
+  }
+  printf(1, "threshold %d (base %d)\n", sp.threshold, sp.basethreshold);
+  printf(1, "npages %d (base %d)\n", sp.npages_to_swap, sp.basenpages);
+  printf(1, "alpha %d beta %d limit %d\n", sp.alpha, sp.beta, sp.limit);
+  exit();
+}
@@ -0,0 +1,10 @@
+// Adaptive swap policy parameters, read and set with swapctl().
+struct swapparams {
+  int threshold;       // Free pages at which kswapd starts reclaiming
+  int npages_to_swap;  // Pages evicted per batch
+  int alpha;           // Percent npages_to_swap grows after a pass
+  int beta;            // Percent threshold shrinks after a pass
+  int limit;           // Largest npages_to_swap
+  int basethreshold;   // threshold relaxes back to this
+  int basenpages;      // npages_to_swap relaxes back to this
+};
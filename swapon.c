@@ -0,0 +1,55 @@
+// Start swapping to a file.
+//   swapon file [prio]            swap to an existing file
+//   swapon -c pages file [prio]   first create it with that many pages
+// Higher priority swap devices are filled first.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+char buf[512];
+
+// Write a file of npages zero-filled pages.
+static int
+create(char *path, int npages)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE|O_RDWR)) < 0)
+    return -1;
+  for(i = 0; i < npages*(4096/sizeof(buf)); i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, prio;
+
+  i = 1;
+  if(argc > 2 && strcmp(argv[1], "-c") == 0)
+    i = 3;
+  if(argc < i+1 || argc > i+2){
+    printf(2, "usage: swapon [-c pages] file [prio]\n");
+    exit();
+  }
+  if(i == 3 && create(argv[i], atoi(argv[2])) < 0){
+    printf(2, "swapon: cannot create %s\n", argv[i]);
+    exit();
+  }
+  prio = 0;
+  if(argc == i+2)
+    prio = argv[i+1][0] == '-' ? -atoi(argv[i+1] + 1) : atoi(argv[i+1]);
+  if(swapon(argv[i], prio) < 0){
+    printf(2, "swapon: cannot swap to %s\n", argv[i]);
+    exit();
+  }
+  exit();
+}
@@ -19,7 +19,7 @@ fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if(addr >= curproc->sz || addr+4 > curproc->sz || faultin(addr, 4, 0) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -39,6 +39,8 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) && faultin((uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -65,6 +67,8 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  if(faultin(i, size, 0) < 0)
+    return -1;
   *pp = (char*)i;
   return 0;
 }
@@ -103,6 +107,16 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_swapctl(void);
+extern int sys_getvmstat(void);
+extern int sys_fltstat(void);
+extern int sys_swapon(void);
+extern int sys_loadstat(void);
+extern int sys_pmemstat(void);
+extern int sys_memlimit(void);
+extern int sys_mlock(void);
+extern int sys_munlock(void);
+extern int sys_madvise(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,6 +140,16 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_swapctl] sys_swapctl,
+[SYS_getvmstat] sys_getvmstat,
+[SYS_fltstat] sys_fltstat,
+[SYS_swapon] sys_swapon,
+[SYS_loadstat] sys_loadstat,
+[SYS_pmemstat] sys_pmemstat,
+[SYS_memlimit] sys_memlimit,
+[SYS_mlock]   sys_mlock,
+[SYS_munlock] sys_munlock,
+[SYS_madvise] sys_madvise,
 };
 
 void
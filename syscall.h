@@ -20,3 +20,13 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_swapctl 22
+#define SYS_getvmstat 23
+#define SYS_fltstat 24
+#define SYS_swapon 25
+#define SYS_loadstat 26
+#define SYS_pmemstat 27
+#define SYS_memlimit 28
+#define SYS_mlock  29
+#define SYS_munlock 30
+#define SYS_madvise 31
@@ -73,7 +73,8 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     faultin((uint)p, n, 1) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -210,7 +211,7 @@ sys_unlink(void)
 
   if(ip->nlink < 1)
     panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
+  if((ip->type == T_DIR && !isdirempty(ip)) || ip->swap){
     iunlockput(ip);
     goto bad;
   }
@@ -442,3 +443,30 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Start swapping to the regular file path with priority prio. The
+// file keeps the reference taken here, so it is never freed.
+int
+sys_swapon(void)
+{
+  char *path;
+  int prio;
+  struct inode *ip;
+
+  if(argstr(0, &path) < 0 || argint(1, &prio) < 0)
+    return -1;
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  if(ip->type != T_FILE || swapfile(ip, prio) < 0){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(ip);
+  end_op();
+  return 0;
+}
@@ -6,6 +6,12 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "swapctl.h"
+#include "vmstat.h"
+#include "fltstat.h"
+#include "loadstat.h"
+#include "pmemstat.h"
+#include "memlimit.h"
 
 int
 sys_fork(void)
@@ -89,3 +95,147 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// read or set the adaptive swap policy parameters
+int
+sys_swapctl(void)
+{
+  struct swapparams *sp, kp;
+  int set, r;
+
+  if(argptr(0, (void*)&sp, sizeof(*sp)) < 0 || argint(1, &set) < 0)
+    return -1;
+  // Work on a kernel copy: touching user memory may fault, which
+  // must not happen while swapctl() holds its lock.
+  kp = *sp;
+  r = swapctl(&kp, set);
+  *sp = kp;
+  return r;
+}
+
+// copy memory and swap statistics to user space
+int
+sys_getvmstat(void)
+{
+  struct vmstat *st, kst;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  getvmstat(&kst);
+  *st = kst;
+  return 0;
+}
+
+// copy page fault statistics to user space, clearing them
+// if the second argument is non-zero. struct fltstat is too big
+// for the kernel stack, so it goes out a piece at a time; the
+// locks are dropped before each piece is stored to user memory.
+int
+sys_fltstat(void)
+{
+  struct fltstat *st;
+  uint hist[NFLTBUCKET], majflt[16], minflt[16];
+  int pid[16];
+  int reset, i, n;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0 || argint(1, &reset) < 0)
+    return -1;
+  for(i = 0; i < NFLTKIND; i++){
+    fltstat(i, hist, reset);
+    memmove(st->hist[i], hist, sizeof(hist));
+  }
+  for(i = 0; i < NPROC; i += n){
+    n = NPROC - i < NELEM(pid) ? NPROC - i : NELEM(pid);
+    procfltstat(i, n, pid, majflt, minflt, reset);
+    memmove(&st->pid[i], pid, n*sizeof(pid[0]));
+    memmove(&st->majflt[i], majflt, n*sizeof(majflt[0]));
+    memmove(&st->minflt[i], minflt, n*sizeof(minflt[0]));
+  }
+  return 0;
+}
+
+// copy the load control state to user space
+int
+sys_loadstat(void)
+{
+  struct loadstat *st, kst;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  loadstat(&kst);
+  *st = kst;
+  return 0;
+}
+
+// copy the memory state of up to n processes to the user array
+// st; returns the number copied
+int
+sys_pmemstat(void)
+{
+  struct pmemstat *st, kst;
+  int n, i, k;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;
+  if(argptr(0, (void*)&st, n*sizeof(*st)) < 0)
+    return -1;
+  k = 0;
+  for(i = 0; i < NPROC && k < n; i++)
+    if(pmemstat(i, &kst) == 0)
+      st[k++] = kst;
+  return k;
+}
+
+// read the memory limits of a process, after setting them if the
+// third argument is non-zero
+int
+sys_memlimit(void)
+{
+  struct memlimit *ml, kml;
+  int pid, set;
+
+  if(argint(0, &pid) < 0 || argptr(1, (void*)&ml, sizeof(*ml)) < 0 ||
+     argint(2, &set) < 0)
+    return -1;
+  kml = *ml;
+  if(memlimit(pid, &kml, set) < 0)
+    return -1;
+  *ml = kml;
+  return 0;
+}
+
+// pin a range of the process's memory against eviction
+int
+sys_mlock(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len < 0)
+    return -1;
+  return mlock(addr, len);
+}
+
+// undo mlock on a range
+int
+sys_munlock(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len < 0)
+    return -1;
+  return munlock(addr, len);
+}
+
+// hint how a range of the process's memory will be used
+int
+sys_madvise(void)
+{
+  int addr, len, advice;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len < 0 ||
+     argint(2, &advice) < 0)
+    return -1;
+  return madvise(addr, len, advice);
+}
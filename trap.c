@@ -7,6 +7,8 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "vmstat.h"
+#include "fltstat.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -14,6 +16,12 @@ extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
 
+// Page fault latency histograms, in cycles.
+struct {
+  struct spinlock lock;
+  uint hist[NFLTKIND][NFLTBUCKET];
+} flthist;
+
 extern int swappage_in(pde_t *pgdir, void *va);
 
 void
@@ -26,6 +34,32 @@ tvinit(void)
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
 
   initlock(&tickslock, "time");
+  initlock(&flthist.lock, "flthist");
+}
+
+// Count a page fault of the given kind that took cycles to handle.
+static void
+fltrecord(int kind, uint64 cycles)
+{
+  int b;
+
+  for(b = 0; cycles > 1 && b < NFLTBUCKET-1; b++)
+    cycles >>= 1;
+  acquire(&flthist.lock);
+  flthist.hist[kind][b]++;
+  release(&flthist.lock);
+}
+
+// Copy the latency histogram of faults of the given kind to hist
+// and, if reset is set, clear it.
+void
+fltstat(int kind, uint *hist, int reset)
+{
+  acquire(&flthist.lock);
+  memmove(hist, flthist.hist[kind], sizeof(flthist.hist[kind]));
+  if(reset)
+    memset(flthist.hist[kind], 0, sizeof(flthist.hist[kind]));
+  release(&flthist.lock);
 }
 
 void
@@ -34,6 +68,19 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// Last steps before returning to user space: wait out a load
+// control suspension, bring back a process swapped out while it
+// slept, and swap out what page faults took past the RSS limit.
+static void
+userret(void)
+{
+  loadwait();
+  if(myproc()->killed)
+    exit();
+  swapinproc();
+  rsstrim();
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
@@ -45,6 +92,7 @@ trap(struct trapframe *tf)
     syscall();
     if(myproc()->killed)
       exit();
+    userret();
     return;
   }
 
@@ -55,7 +103,10 @@ trap(struct trapframe *tf)
       ticks++;
       wakeup(&ticks);
       release(&tickslock);
+      swaprelax();
+      loadctl();
     }
+    pfftick();
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -80,11 +131,38 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_TLBFLUSH:
+    tlbflushintr();
+    lapiceoi();
+    break;
   case T_PGFLT:{
     uint addr = rcr2();
-    if(swappage_in(myproc()->pgdir, (void*) addr) == 0){
-        return;
+    uint64 t0 = rdtsc();
+    struct proc *p = myproc();
+    int r = -1;
+
+    vmstat.pgfaults++;
+    if(p && (tf->err & (PF_PR|PF_WR)) == (PF_PR|PF_WR))
+        r = cowcopy(p->pgdir, addr);  // Write to a copy-on-write page
+    else if(p && !(tf->err & PF_PR)){
+        r = swappage_in(p->pgdir, (void*) addr);  // 1 if it read the disk
+        if(r >= 0)
+            p->pffflt++;
     }
+    fltrecord(r < 0 ? FLT_FAILED : r > 0 ? FLT_MAJOR : FLT_MINOR, rdtsc() - t0);
+    if(r > 0)
+        p->majflt++;
+    else if(r == 0)
+        p->minflt++;
+    if(r >= 0)
+        return;
+    // Out of memory, and the OOM killer picked this process: it
+    // just exits, without the bad-access report below.
+    if(p && p->oomkilled && (tf->cs&3) == DPL_USER)
+        exit();
+    // Out of memory while the kernel copied to or from user memory.
+    if((tf->cs&3) == 0 && faultretry(addr, tf->err & PF_WR) == 0)
+        return;
   }
 
   //PAGEBREAK: 13
@@ -118,4 +196,7 @@ trap(struct trapframe *tf)
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
+
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    userret();
 }
@@ -1,5 +1,11 @@
 struct stat;
 struct rtcdate;
+struct swapparams;
+struct vmstat;
+struct fltstat;
+struct loadstat;
+struct pmemstat;
+struct memlimit;
 
 // system calls
 int fork(void);
@@ -23,6 +29,16 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int swapctl(struct swapparams*, int);
+int getvmstat(struct vmstat*);
+int fltstat(struct fltstat*, int);
+int swapon(char*, int);
+int loadstat(struct loadstat*);
+int pmemstat(struct pmemstat*, int);
+int memlimit(int, struct memlimit*, int);
+int mlock(void*, int);
+int munlock(void*, int);
+int madvise(void*, int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
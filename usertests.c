@@ -7,6 +7,11 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "vmstat.h"
+#include "pmemstat.h"
+#include "memlimit.h"
+#include "fltstat.h"
+#include "madvise.h"
 
 char buf[8192];
 char name[3];
@@ -1737,6 +1742,531 @@ void argptest()
   printf(1, "arg test passed\n");
 }
 
+// once a file is swapped to, it cannot be written, unlinked or
+// swapped to a second time. The file is 16 pages, one short of the
+// FILESLOTS (17) a swap file can hold. A swap file cannot be turned
+// off, so if an earlier run left "swapfile" active the test goes
+// straight to the checks.
+void
+swapfiletest(void)
+{
+  int fd, i;
+
+  printf(stdout, "swap file test\n");
+  memset(buf, 0, sizeof(buf));
+  fd = open("swapfile", O_RDWR);
+  if(fd >= 0){
+    close(fd);
+    swapon("swapfile", -1);  // fails if still active
+  } else {
+    fd = open("swapfile", O_CREATE|O_RDWR);
+    if(fd < 0){
+      printf(stdout, "swap file create failed\n");
+      exit();
+    }
+    for(i = 0; i < 16; i++){
+      if(write(fd, buf, 4096) != 4096){
+        printf(stdout, "swap file write failed\n");
+        exit();
+      }
+    }
+    close(fd);
+    if(swapon("swapfile", -1) < 0){
+      printf(stdout, "swapon failed\n");
+      exit();
+    }
+  }
+  fd = open("swapfile", O_RDWR);
+  if(fd < 0){
+    printf(stdout, "open swap file failed\n");
+    exit();
+  }
+  if(write(fd, buf, 1) >= 0){
+    printf(stdout, "write to active swap file succeeded!\n");
+    exit();
+  }
+  close(fd);
+  if(swapon("swapfile", -1) >= 0){
+    printf(stdout, "second swapon succeeded!\n");
+    exit();
+  }
+  if(unlink("swapfile") >= 0){
+    printf(stdout, "unlink of active swap file succeeded!\n");
+    exit();
+  }
+  printf(stdout, "swap file test ok\n");
+}
+
+// touch half again as much memory as the machine has, in a child,
+// so that reclaim swaps out pages of the other processes.
+void
+mempressure(void)
+{
+  struct vmstat st;
+  char *p;
+  int i, n;
+
+  if(getvmstat(&st) < 0){
+    printf(stdout, "getvmstat failed\n");
+    exit();
+  }
+  n = st.totalpages + st.totalpages/2;
+  if(fork() == 0){
+    p = sbrk(n*4096);
+    if(p != (char*)-1)
+      for(i = 0; i < n; i++)
+        p[i*4096] = i;
+    exit();
+  }
+  wait();
+}
+
+#define COWPAGES 32
+
+void
+cowfill(char *p, int v)
+{
+  int i;
+
+  for(i = 0; i < COWPAGES*4096; i += 512)
+    p[i] = v + i/4096;
+}
+
+int
+cowcheck(char *p, int v)
+{
+  int i;
+
+  for(i = 0; i < COWPAGES*4096; i += 512)
+    if(p[i] != (char)(v + i/4096))
+      return -1;
+  return 0;
+}
+
+// after fork, parent and child share pages copy-on-write; each
+// must see only its own writes, also when the shared pages are
+// swapped out and back in between.
+void
+cowtest(void)
+{
+  int fds[2], pid, round, v;
+  char *p, c;
+
+  printf(stdout, "cow test\n");
+  p = sbrk(COWPAGES*4096);
+  if(p == (char*)-1){
+    printf(stdout, "cow test sbrk failed\n");
+    exit();
+  }
+  v = 1;
+  cowfill(p, v);
+  for(round = 0; round < 2; round++){
+    // The second time the parent's pages are partly swapped out
+    // when it forks.
+    if(round == 1)
+      mempressure();
+    if(pipe(fds) != 0){
+      printf(stdout, "pipe() failed\n");
+      exit();
+    }
+    pid = fork();
+    if(pid < 0){
+      printf(stdout, "fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      close(fds[0]);
+      if(cowcheck(p, v) < 0)
+        exit();
+      cowfill(p, v+1);
+      mempressure();
+      if(cowcheck(p, v+1) == 0)
+        write(fds[1], "y", 1);
+      exit();
+    }
+    close(fds[1]);
+    cowfill(p, v+2);
+    if(read(fds[0], &c, 1) != 1){
+      printf(stdout, "cow test: child saw wrong data\n");
+      exit();
+    }
+    close(fds[0]);
+    wait();
+    if(cowcheck(p, v+2) < 0){
+      printf(stdout, "cow test: parent saw child's writes\n");
+      exit();
+    }
+    v += 2;
+  }
+  sbrk(-COWPAGES*4096);
+  printf(stdout, "cow test ok\n");
+}
+
+// memory state of the current process, or 0
+struct pmemstat*
+mymemstat(void)
+{
+  static struct pmemstat st[NPROC];
+  int i, n;
+
+  n = pmemstat(st, NPROC);
+  for(i = 0; i < n; i++)
+    if(st[i].pid == getpid())
+      return &st[i];
+  return 0;
+}
+
+// resident pages of the current process, or -1
+int
+myrss(void)
+{
+  struct pmemstat *st;
+
+  if((st = mymemstat()) == 0)
+    return -1;
+  return st->rss;
+}
+
+// pages of the current process pinned by mlock(), or -1
+int
+mylocked(void)
+{
+  struct pmemstat *st;
+
+  if((st = mymemstat()) == 0)
+    return -1;
+  return st->locked;
+}
+
+// major page faults of the current process, or -1
+int
+mymajflt(void)
+{
+  static struct fltstat st;
+  int i;
+
+  if(fltstat(&st, 0) < 0)
+    return -1;
+  for(i = 0; i < NPROC; i++)
+    if(st.pid[i] == getpid())
+      return st.majflt[i];
+  return -1;
+}
+
+// mlock() stops at the limit, the limit cannot be raised past the
+// system cap, and locked pages stay resident through memory
+// pressure.
+void
+mlocktest(void)
+{
+  struct memlimit ml, saved;
+  struct vmstat st;
+  char *p;
+  int i, n, flt;
+
+  printf(stdout, "mlock test\n");
+  if(memlimit(getpid(), &saved, 0) < 0){
+    printf(stdout, "memlimit get failed\n");
+    exit();
+  }
+  ml = saved;
+  ml.mlock = 4;
+  memlimit(getpid(), &ml, 1);
+  p = sbrk(8*4096);
+  for(i = 0; i < 8; i++)
+    p[i*4096] = i;
+  if(mlock(p, 4*4096) != 0){
+    printf(stdout, "mlock failed\n");
+    exit();
+  }
+  if(mlock(p, 4096) != 0){
+    printf(stdout, "mlock of a locked page failed\n");
+    exit();
+  }
+  if(mlock(p + 4*4096, 4096) != -1){
+    printf(stdout, "mlock past the limit succeeded!\n");
+    exit();
+  }
+  if(mlock(p, 9*4096) != -1){
+    printf(stdout, "mlock past sz succeeded!\n");
+    exit();
+  }
+  if(mylocked() != 4){
+    printf(stdout, "%d pages locked, not 4\n", mylocked());
+    exit();
+  }
+  if(munlock(p, 8*4096) != 0 || mylocked() != 0){
+    printf(stdout, "munlock failed\n");
+    exit();
+  }
+  if(getvmstat(&st) < 0){
+    printf(stdout, "getvmstat failed\n");
+    exit();
+  }
+  ml.mlock = st.totalpages;
+  if(memlimit(getpid(), &ml, 1) < 0 || ml.mlock > st.totalpages/MLOCKSHARE){
+    printf(stdout, "mlock limit %d above the system cap\n", ml.mlock);
+    exit();
+  }
+
+  // Lock the whole process, code and stack included, so that any
+  // major fault after the pressure means a locked page went out.
+  n = ((uint)sbrk(0) + 4095) / 4096;
+  ml.mlock = n;
+  memlimit(getpid(), &ml, 1);
+  if(mlock(0, (uint)sbrk(0)) != 0 || mylocked() != n){
+    printf(stdout, "mlock of the whole process failed\n");
+    exit();
+  }
+  mempressure();
+  flt = mymajflt();
+  for(i = 0; i < 8; i++){
+    if(p[i*4096] != i){
+      printf(stdout, "mlock: page %d lost its data\n", i);
+      exit();
+    }
+  }
+  if(flt < 0 || mymajflt() != flt){
+    printf(stdout, "locked pages were swapped out\n");
+    exit();
+  }
+  munlock(0, (uint)sbrk(0));
+  if(mylocked() != 0){
+    printf(stdout, "munlock failed\n");
+    exit();
+  }
+  sbrk(-8*4096);
+  memlimit(getpid(), &saved, 1);
+  printf(stdout, "mlock test ok\n");
+}
+
+// limits can only be set on oneself and one's children, the RSS
+// limit holds the resident set down, the two limits together cap
+// sbrk(), and the OOM killer takes the process with the highest
+// badness and spares OOM_DISABLE.
+void
+memlimittest(void)
+{
+  struct memlimit ml, saved;
+  struct vmstat st;
+  int fds[2], back[2], pid, victim, i, rss;
+  char *p, c;
+
+  printf(stdout, "memlimit test\n");
+  if(memlimit(getpid(), &saved, 0) < 0){
+    printf(stdout, "memlimit get failed\n");
+    exit();
+  }
+  // init is not our child: its limits are not ours to set.
+  if(memlimit(1, &ml, 0) < 0 || memlimit(1, &ml, 1) != -1){
+    printf(stdout, "memlimit set on init succeeded!\n");
+    exit();
+  }
+
+  pid = fork();
+  if(pid == 0){
+    ml = saved;
+    ml.rss = 16;
+    if(memlimit(getpid(), &ml, 1) < 0){
+      printf(stdout, "memlimit set failed\n");
+      exit();
+    }
+    p = sbrk(64*4096);
+    for(i = 0; i < 64; i++)
+      p[i*4096] = i;
+    // pmemstat() may fault in a page or two of its own buffer.
+    if((rss = myrss()) > 16 + 2){
+      printf(stdout, "rss %d above limit 16\n", rss);
+      exit();
+    }
+    for(i = 0; i < 64; i++){
+      if(p[i*4096] != i){
+        printf(stdout, "memlimit: page %d lost its data\n", i);
+        exit();
+      }
+    }
+    ml.swap = 16;
+    if(memlimit(getpid(), &ml, 1) < 0 || sbrk(0) != p + 64*4096){
+      printf(stdout, "memlimit set failed\n");
+      exit();
+    }
+    if(sbrk(4096) != (char*)-1){
+      printf(stdout, "sbrk past rss+swap limit succeeded!\n");
+      exit();
+    }
+    exit();
+  }
+  wait();
+
+  // Out of memory: A pins memory until the OOM killer stops it.
+  // B is small and sleeps; the test itself is exempt.
+  ml = saved;
+  ml.oomadj = OOM_DISABLE;
+  memlimit(getpid(), &ml, 1);
+  if(pipe(fds) != 0 || pipe(back) != 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid == 0){
+    ml.oomadj = 0;
+    memlimit(getpid(), &ml, 1);
+    read(fds[0], &c, 1);
+    write(back[1], "y", 1);
+    exit();
+  }
+  victim = fork();
+  if(victim == 0){
+    ml.oomadj = 1000;
+    if(getvmstat(&st) == 0)
+      ml.mlock = st.totalpages / MLOCKSHARE;
+    memlimit(getpid(), &ml, 1);
+    for(;;){
+      p = sbrk(4096);
+      p[0] = 1;
+      mlock(p, 4096);
+    }
+  }
+  if(pid < 0 || victim < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(wait() != victim){
+    printf(stdout, "oom killer picked the wrong process\n");
+    exit();
+  }
+  write(fds[1], "x", 1);
+  if(read(back[0], &c, 1) != 1){
+    printf(stdout, "oom killer killed a bystander\n");
+    exit();
+  }
+  wait();
+  close(fds[0]);
+  close(fds[1]);
+  close(back[0]);
+  close(back[1]);
+  memlimit(getpid(), &saved, 1);
+  printf(stdout, "memlimit test ok\n");
+}
+
+// MADV_DONTNEED drops pages so they read back as zeros, the other
+// advice leaves the data alone, and bad arguments are refused.
+void
+madvisetest(void)
+{
+  static int advice[] = { MADV_WILLNEED, MADV_SEQUENTIAL, MADV_RANDOM,
+                          MADV_NORMAL };
+  char *p;
+  int i, j;
+
+  printf(stdout, "madvise test\n");
+  p = sbrk(8*4096);
+  if(p == (char*)-1){
+    printf(stdout, "madvise test sbrk failed\n");
+    exit();
+  }
+  for(i = 0; i < 8*4096; i += 512)
+    p[i] = 1 + i/4096;
+
+  if(madvise(p + 1, 4096, MADV_DONTNEED) != -1){
+    printf(stdout, "madvise of an unaligned address succeeded!\n");
+    exit();
+  }
+  if(madvise(p, 9*4096, MADV_DONTNEED) != -1){
+    printf(stdout, "madvise past sz succeeded!\n");
+    exit();
+  }
+  if(madvise(p, 4096, 99) != -1){
+    printf(stdout, "madvise with bad advice succeeded!\n");
+    exit();
+  }
+  for(j = 0; j < sizeof(advice)/sizeof(advice[0]); j++){
+    if(madvise(p, 8*4096, advice[j]) != 0){
+      printf(stdout, "madvise advice %d failed\n", advice[j]);
+      exit();
+    }
+  }
+  for(i = 0; i < 8*4096; i += 512){
+    if(p[i] != 1 + i/4096){
+      printf(stdout, "madvise changed page %d\n", i/4096);
+      exit();
+    }
+  }
+
+  if(madvise(p + 2*4096, 4*4096, MADV_DONTNEED) != 0){
+    printf(stdout, "madvise DONTNEED failed\n");
+    exit();
+  }
+  for(i = 0; i < 8*4096; i += 512){
+    if(p[i] != (i/4096 >= 2 && i/4096 < 6 ? 0 : 1 + i/4096)){
+      printf(stdout, "madvise DONTNEED: page %d wrong\n", i/4096);
+      exit();
+    }
+  }
+  sbrk(-8*4096);
+  printf(stdout, "madvise test ok\n");
+}
+
+// sbrk() only reserves address space: pages come in zero-filled
+// on first touch, also after a shrink and regrow, and a touch
+// above sz still kills the process.
+void
+lazysbrktest(void)
+{
+  int fds[2], pid, rss, i;
+  char *p, *a, c;
+
+  printf(stdout, "lazy sbrk test\n");
+  p = sbrk(4*4096);
+  for(i = 0; i < 4*4096; i += 512)
+    p[i] = 1;
+  sbrk(-4*4096);
+  if(sbrk(4*4096) != p){
+    printf(stdout, "lazy sbrk regrow failed\n");
+    exit();
+  }
+  for(i = 0; i < 4*4096; i += 512){
+    if(p[i] != 0){
+      printf(stdout, "lazy sbrk: regrown page %d not zero\n", i/4096);
+      exit();
+    }
+  }
+  sbrk(-4*4096);
+
+  rss = myrss();
+  p = sbrk(64*4096);
+  if(p == (char*)-1 || myrss() > rss){
+    printf(stdout, "lazy sbrk: untouched pages are resident\n");
+    exit();
+  }
+  sbrk(-64*4096);
+
+  if(pipe(fds) != 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    a = (char*)(((uint)sbrk(0) + 4095) / 4096 * 4096 + 4096);
+    *a = 1;
+    write(fds[1], "x", 1);
+    exit();
+  }
+  close(fds[1]);
+  wait();
+  if(read(fds[0], &c, 1) != 0){
+    printf(stdout, "lazy sbrk: touch above sz was not killed\n");
+    exit();
+  }
+  close(fds[0]);
+  printf(stdout, "lazy sbrk test ok\n");
+}
+
 unsigned long randstate = 1;
 unsigned int
 rand()
@@ -1757,6 +2287,7 @@ main(int argc, char *argv[])
   close(open("usertests.ran", O_CREATE));
 
   argptest();
+  swapfiletest();
   createdelete();
   linkunlink();
   concreate();
@@ -1797,6 +2328,12 @@ main(int argc, char *argv[])
 
   uio();
 
+  cowtest();
+  memlimittest();
+  mlocktest();
+  madvisetest();
+  lazysbrktest();
+
   exectest();
 
   exit();
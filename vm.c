@@ -6,6 +6,8 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "traps.h"
+#include "vmstat.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -54,6 +56,66 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   return &pgtab[PTX(va)];
 }
 
+// Return the next non-zero PTE for an address at or above *va and
+// below end, and set *va to that address. A page directory entry
+// that is not present skips its whole 4MB in one step, so a scan
+// costs in proportion to the page tables actually allocated.
+// Returns 0 when there are no more. Used as
+//   for(va = start; (pte = nextpte(pgdir, &va, end)) != 0; va += PGSIZE)
+pte_t *
+nextpte(pde_t *pgdir, uint *va, uint end)
+{
+  pde_t *pde;
+  pte_t *pgtab;
+  uint a;
+
+  a = PGROUNDDOWN(*va);
+  while(a < end){
+    pde = &pgdir[PDX(a)];
+    if(!(*pde & PTE_P)){
+      a = PGADDR(PDX(a) + 1, 0, 0);
+      continue;
+    }
+    pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
+    do {
+      if(pgtab[PTX(a)]){
+        *va = a;
+        return &pgtab[PTX(a)];
+      }
+      a += PGSIZE;
+    } while(a < end && PTX(a) != 0);
+  }
+  return 0;
+}
+
+// Number of pages below sz that are swapped out.
+int
+swappedpages(pde_t *pgdir, uint sz)
+{
+  pte_t *pte;
+  uint va;
+  int n = 0;
+
+  for(va = 0; (pte = nextpte(pgdir, &va, sz)) != 0; va += PGSIZE)
+    if(!(*pte & PTE_P))
+      n++;
+  return n;
+}
+
+// Number of pages below sz that are resident in memory.
+int
+residentpages(pde_t *pgdir, uint sz)
+{
+  pte_t *pte;
+  uint va;
+  int n = 0;
+
+  for(va = 0; (pte = nextpte(pgdir, &va, sz)) != 0; va += PGSIZE)
+    if(*pte & PTE_P)
+      n++;
+  return n;
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
@@ -189,6 +251,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
   mem = kalloc();
   memset(mem, 0, PGSIZE);
   mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U);
+  frameadd(V2P(mem), 0);
   memmove(mem, init, sz);
 }
 
@@ -233,19 +296,9 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   for(; a < newsz; a += PGSIZE){
     mem = kalloc();
     if(mem == 0){
-      extern void checkAswap(void);
-      checkAswap();
-
-      mem = kalloc();
-      if(mem == 0){
-        checkAswap();
-        mem = kalloc();
-        if(mem == 0){
-            cprintf("allocuvm out of memeory\n");
-            deallocuvm(pgdir, newsz, oldsz);
-            return 0;
-        }
-      }
+      cprintf("allocuvm out of memory\n");
+      deallocuvm(pgdir, newsz, oldsz);
+      return 0;
     }
     memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
@@ -254,6 +307,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       kfree(mem);
       return 0;
     }
+    frameadd(V2P(mem), a);
   }
   return newsz;
 }
@@ -271,19 +325,22 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   if(newsz >= oldsz)
     return oldsz;
 
-  a = PGROUNDUP(newsz);
-  for(; a  < oldsz; a += PGSIZE){
-    pte = walkpgdir(pgdir, (char*)a, 0);
-    if(!pte)
-      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
-    else if((*pte & PTE_P) != 0){
+  for(a = PGROUNDUP(newsz); (pte = nextpte(pgdir, &a, oldsz)) != 0; a += PGSIZE){
+    if(*pte & PTE_EVICT)
+      swapwait(pte);
+    if((*pte & PTE_P) != 0){
       pa = PTE_ADDR(*pte);
       if(pa == 0)
         panic("kfree");
       char *v = P2V(pa);
-      kfree(v);
-      *pte = 0;
-    }
+      // A page shared copy-on-write is freed by its last user.
+      if(kunref(v)){
+        framedel(pa, *pte & PTE_A);
+        kfree(v);
+      }
+    } else
+      swapdrop(*pte);  // Swapped out
+    *pte = 0;
   }
   return newsz;
 }
@@ -321,80 +378,225 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. Resident pages are not copied: parent and
+// child share them read-only, with PTE_COW marking the ones that
+// were writable, until one of them writes (see cowcopy). The
+// parent's page table must be the one loaded on this CPU.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
+  pte_t *pte, old;
   uint pa, i, flags;
   char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(*pte & PTE_P){
-        pa = PTE_ADDR(*pte);
-        flags = PTE_FLAGS(*pte);
-        if((mem = kalloc()) == 0){
-            checkAswap();
-            mem = kalloc();
-            if(mem == 0){
-                checkAswap();
-                mem = kalloc();
-                if(mem == 0){
-                    goto bad;
-                }
-            }
-        }
-        memmove(mem, (char*)P2V(pa), PGSIZE);
-        if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0){
-            kfree(mem);
+  for(i = 0; (pte = nextpte(pgdir, &i, sz)) != 0; i += PGSIZE){
+    if(*pte & PTE_EVICT)
+      swapwait(pte);
+    if(*pte & PTE_Z){
+        // Compressed pages are shared by reference
+        pte_t* child = walkpgdir(d,(void*)i,1);
+        if(child == 0)
             goto bad;
-        }
-    }else if(*pte != 0){
+        zdup(PTE_ADDR(*pte) >> 12);
+        *child = *pte;
+        continue;
+    }
+    if(!(*pte & PTE_P)){
         uint slot = PTE_ADDR(*pte) >> 12;
         flags = PTE_FLAGS(*pte);
         int new = duplicateslot(slot);
-        if(new < 0){
-            if(swappage_in(pgdir, (void*)i) == 0){
-                pte = walkpgdir(pgdir, (void*)i, 0);
-                if(!pte || !(*pte & PTE_P))
-                    goto bad;
-                pa = PTE_ADDR(*pte);
-                flags = PTE_FLAGS(*pte);
-
-                if((mem = kalloc()) == 0)
-                    goto bad;
-                
-                memmove(mem, (char*)P2V(pa), PGSIZE);
-                if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0){
-                    kfree(mem);
-                    goto bad;
-                }
-            }else{
-                goto bad;
-            }
-        }else{
+        if(new >= 0){
             pte_t entr = (new << 12) | (flags & ~PTE_P);
             pte_t* child = walkpgdir(d,(void*)i,1);
             if(child == 0){
+                freeslot(new);
                 goto bad;
             }
             *child = entr;
+            continue;
+        }
+        // The slot could not be shared: share the page in memory.
+        if(swappage_in(pgdir, (void*)i) < 0)
+            goto bad;
+        pte = walkpgdir(pgdir, (void*)i, 0);
+        if(!pte || !(*pte & PTE_P))
+            goto bad;
+    }
+    if((*pte & PTE_P) && framelocked(PTE_ADDR(*pte))){
+        // A pinned page stays private to the parent: copy it now.
+        if((mem = kalloc()) == 0)
+            goto bad;
+        memmove(mem, (char*)P2V(PTE_ADDR(*pte)), PGSIZE);
+        if(mappages(d, (void*)i, PGSIZE, V2P(mem), PTE_FLAGS(*pte)) < 0){
+            kfree(mem);
+            goto bad;
+        }
+        frameadd(V2P(mem), i);
+        continue;
+    }
+    if(*pte & PTE_P){
+        old = *pte;
+        pa = PTE_ADDR(old);
+        flags = PTE_FLAGS(old);
+        if(flags & PTE_W)
+            flags = (flags & ~PTE_W) | PTE_COW;
+        // Take the child's reference before the page is shared, so
+        // that reclaim of the parent's page cannot free it under the
+        // child. Look again if kswapd started swapping it out
+        // meanwhile.
+        if(!kref(P2V(pa))){
+            i -= PGSIZE;
+            continue;
+        }
+        if(cmpxchg(pte, old, pa | flags) != old){
+            if(kunref(P2V(pa))){
+                framedel(pa, 0);
+                kfree(P2V(pa));
+            }
+            i -= PGSIZE;
+            continue;
+        }
+        if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0){
+            if(kunref(P2V(pa))){
+                framedel(pa, 0);
+                kfree(P2V(pa));
+            }
+            goto bad;
         }
-
     }
   }
+  // Drop the parent's now stale writable TLB entries.
+  lcr3(V2P(pgdir));
   return d;
 
 bad:
+  lcr3(V2P(pgdir));
   freevm(d);
   return 0;
 }
 
+// Give the process its own copy of the copy-on-write page at va
+// after a write to it. The last process sharing a page just gets
+// write access back. Returns -1 if va is not a copy-on-write page
+// or memory is exhausted.
+int
+cowcopy(pde_t *pgdir, uint va)
+{
+  pte_t *pte, old;
+  uint pa, flags;
+  char *mem;
+
+  va = PGROUNDDOWN(va);
+  pte = walkpgdir(pgdir, (void*)va, 0);
+  if(!pte || !(*pte & PTE_P) || !(*pte & PTE_COW))
+    return -1;
+  vmstat.cowfaults++;
+  old = *pte;
+  pa = PTE_ADDR(old);
+  flags = (PTE_FLAGS(old) | PTE_W) & ~PTE_COW;
+  // If kswapd swaps the page out in the meantime, the PTE no
+  // longer matches old; the access then faults again and swaps
+  // it back in.
+  if(krefcount(P2V(pa)) == 1){
+    if(cmpxchg(pte, old, pa | flags) == old)
+      tlbflush(pgdir, &va, 1);
+    return 0;
+  }
+  if((mem = kalloc()) == 0)
+    return -1;
+  memmove(mem, (char*)P2V(pa), PGSIZE);
+  if(cmpxchg(pte, old, V2P(mem) | flags) != old){
+    kfree(mem);
+    return 0;
+  }
+  tlbflush(pgdir, &va, 1);
+  frameadd(V2P(mem), va);
+  if(kunref(P2V(pa))){
+    framedel(pa, 0);
+    kfree(P2V(pa));
+  }
+  return 0;
+}
+
+#define TLBBATCH 16   // Most pages one shootdown invalidates singly
+
+// TLB shootdown in progress. Only one CPU runs a shootdown at a
+// time; the others it targets flush and clear their bit in pending.
+struct {
+  volatile uint busy;     // A shootdown is in progress
+  pde_t *pgdir;           // Page table whose entries changed
+  uint va[TLBBATCH];      // Pages to invalidate
+  int n;                  // Number of pages, or -1 for all
+  volatile uint pending;  // CPUs that have yet to flush, one bit each
+} shootdown;
+
+// Flush this CPU's TLB for the shootdown in progress, if it is
+// one of the targets. Interrupts must be off.
+void
+tlbflushintr(void)
+{
+  uint me = 1U << cpuid();
+  int i;
+
+  if(!(shootdown.pending & me))
+    return;
+  if(rcr3() == V2P(shootdown.pgdir)){
+    if(shootdown.n < 0)
+      lcr3(rcr3());
+    else
+      for(i = 0; i < shootdown.n; i++)
+        invlpg((void*)shootdown.va[i]);
+  }
+  atomicand(&shootdown.pending, ~me);
+}
+
+// Invalidate the n pages va[] of pgdir in every TLB that may hold
+// them: this CPU's if pgdir is loaded, and those of the other CPUs
+// currently running a process with pgdir, which are interrupted
+// once for the whole batch. Returns when all of them are done.
+// The caller must not hold a spinlock, since the targets may be
+// spinning for it with interrupts off.
+void
+tlbflush(pde_t *pgdir, uint *va, int n)
+{
+  struct cpu *c;
+  uint targets;
+  int i;
+
+  pushcli();
+  if(rcr3() == V2P(pgdir)){
+    for(i = 0; i < n; i++)
+      invlpg((void*)va[i]);
+  }
+  targets = 0;
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(c != mycpu() && c->proc && c->proc->pgdir == pgdir)
+      targets |= 1U << (c - cpus);
+  if(targets == 0){
+    popcli();
+    return;
+  }
+
+  // Serve other CPUs' shootdowns while waiting for ours to start.
+  while(xchg(&shootdown.busy, 1) != 0)
+    tlbflushintr();
+  shootdown.pgdir = pgdir;
+  shootdown.n = n > TLBBATCH ? -1 : n;
+  for(i = 0; i < shootdown.n; i++)
+    shootdown.va[i] = va[i];
+  xchg(&shootdown.pending, targets);
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(targets & (1U << (c - cpus)))
+      lapicipi(c->apicid, T_TLBFLUSH);
+  while(shootdown.pending)
+    tlbflushintr();
+  xchg(&shootdown.busy, 0);
+  popcli();
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -427,7 +629,7 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0){
         pte_t *pte = walkpgdir(pgdir, (char*)va0, 0);
-        if(pte && !(*pte & PTE_P)){
+        if(pte == 0 || !(*pte & PTE_P)){
             if(swappage_in(pgdir, (char*)va0) < 0)
                 return -1;
             
@@ -439,6 +641,13 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
             return -1;
         }
     }
+    // Writing through the kernel mapping bypasses PTE_W, so a
+    // copy-on-write page has to be copied here.
+    pte_t *pte = walkpgdir(pgdir, (char*)va0, 0);
+    if(*pte & PTE_COW){
+      if(cowcopy(pgdir, va0) < 0 || (pa0 = uva2ka(pgdir, (char*)va0)) == 0)
+        return -1;
+    }
       
     n = PGSIZE - (va - va0);
     if(n > len)
@@ -0,0 +1,67 @@
+// Print memory and swap statistics.
+//   vmstat [interval [count]]
+// The first line shows totals since boot. With an interval (in
+// clock ticks), further lines follow every interval and show the
+// events during it, until count lines have been printed.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "vmstat.h"
+
+static void
+header(void)
+{
+  printf(1, "free swap zswap thresh | flt cow sin sout scan recl kswapd direct rahit ramiss pout pin zero\n");
+}
+
+static void
+line(struct vmstat *now, struct vmstat *prev)
+{
+  printf(1, "%d %d %d %d | ",
+         now->freepages, now->swapused, now->zstored, now->threshold);
+  printf(1, "%d %d %d %d %d %d %d %d %d %d %d %d %d\n",
+         now->pgfaults - prev->pgfaults,
+         now->cowfaults - prev->cowfaults,
+         now->swapins - prev->swapins,
+         now->swapouts - prev->swapouts,
+         now->pgscanned - prev->pgscanned,
+         now->pgreclaimed - prev->pgreclaimed,
+         now->kswapdruns - prev->kswapdruns,
+         now->directreclaims - prev->directreclaims,
+         now->rahits - prev->rahits,
+         now->ramisses - prev->ramisses,
+         now->procswapouts - prev->procswapouts,
+         now->procswapins - prev->procswapins,
+         now->pgzeroed - prev->pgzeroed);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat prev, now;
+  int interval, count, i;
+
+  interval = argc > 1 ? atoi(argv[1]) : 0;
+  count = argc > 2 ? atoi(argv[2]) : -1;
+  if(argc > 3 || (argc > 1 && interval <= 0)){
+    printf(2, "usage: vmstat [interval [count]]\n");
+    exit();
+  }
+
+  memset(&prev, 0, sizeof(prev));
+  if(getvmstat(&now) < 0){
+    printf(2, "vmstat: getvmstat failed\n");
+    exit();
+  }
+  printf(1, "total %d pages, %d swap slots\n", now.totalpages, now.swapslots);
+  header();
+  line(&now, &prev);
+  for(i = 1; interval > 0 && i != count; i++){
+    prev = now;
+    sleep(interval);
+    getvmstat(&now);
+    line(&now, &prev);
+  }
+  exit();
+}
@@ -0,0 +1,25 @@
+// Memory and swap statistics returned by getvmstat(). Counters
+// count events since boot; the rest describe the current state.
+struct vmstat {
+  uint ticks;           // Clock ticks at the time of the snapshot
+  int totalpages;       // Pages managed by the page allocator
+  int freepages;        // Pages on the free list
+  int swapslots;        // Swap slots on disk
+  int swapused;         // Swap slots in use
+  int zstored;          // Pages held compressed in memory
+  int zpoolpages;       // Pages used by the compressed pool
+  int threshold;        // Current low watermark
+  uint pgfaults;        // Page faults
+  uint cowfaults;       // Copy-on-write faults
+  uint swapins;         // Pages swapped in, including readahead
+  uint swapouts;        // Pages swapped out
+  uint rahits;          // Readahead pages later used
+  uint ramisses;        // Readahead pages never used
+  uint kswapdruns;      // Reclaim passes by kswapd
+  uint directreclaims;  // Reclaims run by kalloc() itself
+  uint pgscanned;       // Frames examined by the CLOCK hand
+  uint pgreclaimed;     // Frames freed by reclaim
+  uint procswapouts;    // Sleeping processes swapped out whole
+  uint procswapins;     // Such processes brought back in bulk
+  uint pgzeroed;        // Heap pages zero-filled on first touch
+};
@@ -130,6 +130,30 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Atomically and mask into *addr.
+static inline void
+atomicand(volatile uint *addr, uint mask)
+{
+  asm volatile("lock; andl %1, %0" :
+               "+m" (*addr) :
+               "r" (mask) :
+               "cc");
+}
+
+// Atomically set *addr to newval if it equals old.
+// Returns the value *addr had.
+static inline uint
+cmpxchg(volatile uint *addr, uint old, uint newval)
+{
+  uint result;
+
+  asm volatile("lock; cmpxchgl %2, %0" :
+               "+m" (*addr), "=a" (result) :
+               "r" (newval), "1" (old) :
+               "cc", "memory");
+  return result;
+}
+
 static inline uint
 rcr2(void)
 {
@@ -144,6 +168,29 @@ lcr3(uint val)
   asm volatile("movl %0,%%cr3" : : "r" (val));
 }
 
+static inline uint64
+rdtsc(void)
+{
+  uint lo, hi;
+
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return (uint64)hi << 32 | lo;
+}
+
+static inline void
+invlpg(void *addr)
+{
+  asm volatile("invlpg (%0)" : : "r" (addr) : "memory");
+}
+
+static inline uint
+rcr3(void)
+{
+  uint val;
+  asm volatile("movl %%cr3,%0" : "=r" (val));
+  return val;
+}
+
 //PAGEBREAK: 36
 // Layout of the trap frame built on the stack by the
 // hardware and by trapasm.S, and passed to trap().
@@ -0,0 +1,365 @@
+// Compressed swap pool. swapout() first tries to store an evicted
+// page here, compressed with a small LZ77 coder, and only falls
+// back to the disk swap area when the pool is full or the page does
+// not compress to at most half a page. A PTE for a page held here
+// has PTE_Z set and a pool handle in place of the slot number.
+//
+// A page that is one 32-bit word repeated (most often all zeroes)
+// is not compressed at all: its entry records the word and takes
+// no pool space, and swapping it in just fills a fresh page.
+//
+// The pool grows a page at a time from kalloc() up to ZPOOLPAGES
+// pages. Each pool page is split into ZCHUNK-byte chunks, and a
+// compressed page takes a contiguous run of chunks in one pool page.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "zswap.h"
+
+#define ZCHUNK     64                 // Allocation unit in pool pages
+#define ZCHUNKS    (PGSIZE/ZCHUNK)    // Chunks per pool page
+#define ZMAXLEN    (PGSIZE/2)         // Largest compressed page kept
+
+#define LZMINMATCH 3
+#define LZMAXMATCH (0x7f + LZMINMATCH)
+#define LZMAXLIT   0x80
+#define LZHASHBITS 10
+
+// A compressed page.
+struct zentry {
+  int ref;        // PTEs referring to this entry, 0 if free
+  ushort page;    // Pool page holding the data
+  ushort chunk;   // First chunk within that page
+  ushort len;     // Compressed length in bytes, 0 if same-filled
+  uint fill;      // Repeated word of a same-filled page
+};
+
+struct {
+  struct spinlock lock;
+  char *pages[ZPOOLPAGES];        // Pool pages, 0 if not allocated
+  uint map[ZPOOLPAGES][ZCHUNKS/32]; // Chunk bitmap per pool page
+  int nchunks[ZPOOLPAGES];        // Chunks in use per pool page
+  struct zentry ent[NZENTRY];
+  struct zswapstat stat;
+
+  // Compressor state, only used with lock held.
+  ushort htab[1<<LZHASHBITS];     // Last position+1 of each 3-byte hash
+  uchar buf[ZMAXLEN];             // Compression output
+} zpool;
+
+void
+zswapinit(void)
+{
+  initlock(&zpool.lock, "zpool");
+}
+
+static uint
+lzhash(uchar *p)
+{
+  return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761U) >> (32 - LZHASHBITS);
+}
+
+// Append the literals src[0..n) to dst at *o. Returns -1 if that
+// would go past max.
+static int
+lzliterals(uchar *src, int n, uchar *dst, int *o, int max)
+{
+  int k;
+
+  while(n > 0){
+    k = n < LZMAXLIT ? n : LZMAXLIT;
+    if(*o + 1 + k > max)
+      return -1;
+    dst[(*o)++] = k - 1;
+    memmove(dst + *o, src, k);
+    *o += k;
+    src += k;
+    n -= k;
+  }
+  return 0;
+}
+
+// Compress a page into dst. The output is a sequence of tokens:
+// a byte below 0x80 is followed by that many plus one literal
+// bytes; a byte 0x80|n is a match of n+3 bytes at the 16-bit
+// little-endian distance that follows. Returns the compressed
+// length, or -1 if it would exceed max.
+static int
+lzcompress(uchar *src, uchar *dst, int max)
+{
+  int i, lit, o, cand, len;
+  uint h;
+
+  memset(zpool.htab, 0, sizeof(zpool.htab));
+  i = lit = o = 0;
+  while(i + LZMINMATCH <= PGSIZE){
+    h = lzhash(src + i);
+    cand = zpool.htab[h] - 1;
+    zpool.htab[h] = i + 1;
+    if(cand < 0 || src[cand] != src[i] || src[cand+1] != src[i+1] ||
+       src[cand+2] != src[i+2]){
+      i++;
+      continue;
+    }
+    len = LZMINMATCH;
+    while(i + len < PGSIZE && len < LZMAXMATCH && src[cand+len] == src[i+len])
+      len++;
+    if(lzliterals(src + lit, i - lit, dst, &o, max) < 0 || o + 3 > max)
+      return -1;
+    dst[o++] = 0x80 | (len - LZMINMATCH);
+    dst[o++] = (i - cand) & 0xff;
+    dst[o++] = (i - cand) >> 8;
+    i += len;
+    lit = i;
+  }
+  if(lzliterals(src + lit, PGSIZE - lit, dst, &o, max) < 0)
+    return -1;
+  return o;
+}
+
+// Expand len bytes of compressed data into a page.
+static int
+lzdecompress(uchar *src, int len, uchar *dst)
+{
+  int i, o, n, off;
+  uchar c;
+
+  i = o = 0;
+  while(i < len){
+    c = src[i++];
+    if(c < 0x80){
+      n = c + 1;
+      if(i + n > len || o + n > PGSIZE)
+        return -1;
+      memmove(dst + o, src + i, n);
+      i += n;
+    } else {
+      n = (c & 0x7f) + LZMINMATCH;
+      if(i + 2 > len)
+        return -1;
+      off = src[i] | src[i+1] << 8;
+      i += 2;
+      if(off == 0 || off > o || o + n > PGSIZE)
+        return -1;
+      // Byte at a time: the match may overlap its own output.
+      for(; n > 0; n--, o++)
+        dst[o] = dst[o - off];
+      continue;
+    }
+    o += n;
+  }
+  return o == PGSIZE ? 0 : -1;
+}
+
+// If the page at v is one word repeated, set *fill to it.
+static int
+samefilled(uint *v, uint *fill)
+{
+  int i;
+
+  for(i = 1; i < PGSIZE/sizeof(uint); i++)
+    if(v[i] != v[0])
+      return 0;
+  *fill = v[0];
+  return 1;
+}
+
+static int
+chunkused(int pg, int c)
+{
+  return (zpool.map[pg][c/32] >> (c%32)) & 1;
+}
+
+// Find n free contiguous chunks in pool page pg. Returns the first
+// chunk or -1.
+static int
+chunkrun(int pg, int n)
+{
+  int c, run;
+
+  run = 0;
+  for(c = 0; c < ZCHUNKS; c++){
+    if(chunkused(pg, c))
+      run = 0;
+    else if(++run == n)
+      return c - n + 1;
+  }
+  return -1;
+}
+
+static void
+chunkmark(int pg, int c, int n, int used)
+{
+  for(; n > 0; n--, c++){
+    if(used)
+      zpool.map[pg][c/32] |= 1U << (c%32);
+    else
+      zpool.map[pg][c/32] &= ~(1U << (c%32));
+  }
+}
+
+// Find room for len bytes, growing the pool if needed. Sets *pg
+// and *c. Caller must hold zpool.lock.
+static int
+zalloc(int len, int *pg, int *c)
+{
+  int n, i, empty;
+
+  n = (len + ZCHUNK - 1) / ZCHUNK;
+  empty = -1;
+  for(i = 0; i < ZPOOLPAGES; i++){
+    if(zpool.pages[i] == 0){
+      if(empty < 0)
+        empty = i;
+      continue;
+    }
+    if(ZCHUNKS - zpool.nchunks[i] >= n && (*c = chunkrun(i, n)) >= 0){
+      *pg = i;
+      goto found;
+    }
+  }
+  // With zpool.lock held kalloc() does not recurse into reclaim;
+  // it only hands out a page already free.
+  if(empty < 0 || (zpool.pages[empty] = kalloc()) == 0)
+    return -1;
+  zpool.stat.poolpages++;
+  *pg = empty;
+  *c = 0;
+
+found:
+  chunkmark(*pg, *c, n, 1);
+  zpool.nchunks[*pg] += n;
+  return 0;
+}
+
+// Compress the page at kernel address v into the pool. Returns a
+// handle with one reference, or -1 if the page compresses badly or
+// the pool is full.
+int
+zstore(char *v)
+{
+  int h, len, pg, c;
+  struct zentry *e;
+  uint fill;
+
+  acquire(&zpool.lock);
+  for(h = 0; h < NZENTRY; h++)
+    if(zpool.ent[h].ref == 0)
+      break;
+  if(h == NZENTRY){
+    zpool.stat.full++;
+    release(&zpool.lock);
+    return -1;
+  }
+  e = &zpool.ent[h];
+  if(samefilled((uint*)v, &fill)){
+    e->ref = 1;
+    e->len = 0;
+    e->fill = fill;
+    zpool.stat.samefilled++;
+    zpool.stat.elided++;
+    release(&zpool.lock);
+    return h;
+  }
+  if((len = lzcompress((uchar*)v, zpool.buf, ZMAXLEN)) < 0){
+    zpool.stat.rejected++;
+    release(&zpool.lock);
+    return -1;
+  }
+  if(zalloc(len, &pg, &c) < 0){
+    zpool.stat.full++;
+    release(&zpool.lock);
+    return -1;
+  }
+  e->ref = 1;
+  e->page = pg;
+  e->chunk = c;
+  e->len = len;
+  memmove(zpool.pages[pg] + c*ZCHUNK, zpool.buf, len);
+  zpool.stat.stored++;
+  zpool.stat.bytes += len;
+  release(&zpool.lock);
+  return h;
+}
+
+// Decompress entry h into the page at kernel address v.
+int
+zload(int h, char *v)
+{
+  struct zentry *e;
+  int r;
+
+  if(h < 0 || h >= NZENTRY)
+    return -1;
+  acquire(&zpool.lock);
+  e = &zpool.ent[h];
+  if(e->ref == 0){
+    release(&zpool.lock);
+    return -1;
+  }
+  if(e->len == 0){
+    for(r = 0; r < PGSIZE/sizeof(uint); r++)
+      ((uint*)v)[r] = e->fill;
+    r = 0;
+  } else
+    r = lzdecompress((uchar*)zpool.pages[e->page] + e->chunk*ZCHUNK, e->len, (uchar*)v);
+  release(&zpool.lock);
+  return r;
+}
+
+// Another PTE (a forked child) refers to entry h.
+void
+zdup(int h)
+{
+  acquire(&zpool.lock);
+  zpool.ent[h].ref++;
+  release(&zpool.lock);
+}
+
+// Drop one reference to entry h, freeing it with the last one.
+// An empty pool page goes back to the page allocator.
+void
+zfree(int h)
+{
+  struct zentry *e;
+  char *v = 0;
+  int n;
+
+  if(h < 0 || h >= NZENTRY)
+    return;
+  acquire(&zpool.lock);
+  e = &zpool.ent[h];
+  if(e->ref == 0 || --e->ref > 0){
+    release(&zpool.lock);
+    return;
+  }
+  if(e->len == 0){
+    zpool.stat.samefilled--;
+    release(&zpool.lock);
+    return;
+  }
+  n = (e->len + ZCHUNK - 1) / ZCHUNK;
+  chunkmark(e->page, e->chunk, n, 0);
+  zpool.stat.stored--;
+  zpool.stat.bytes -= e->len;
+  if((zpool.nchunks[e->page] -= n) == 0){
+    v = zpool.pages[e->page];
+    zpool.pages[e->page] = 0;
+    zpool.stat.poolpages--;
+  }
+  release(&zpool.lock);
+  if(v)
+    kfree(v);
+}
+
+void
+zswapstat(struct zswapstat *st)
+{
+  acquire(&zpool.lock);
+  *st = zpool.stat;
+  release(&zpool.lock);
+}
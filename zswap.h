@@ -0,0 +1,10 @@
+// Compressed swap pool statistics.
+struct zswapstat {
+  int stored;     // Compressed pages held in the pool
+  int samefilled; // Same-filled pages held, taking no pool space
+  int elided;     // Page-outs of same-filled pages since boot
+  int poolpages;  // Pages of memory the pool occupies
+  int bytes;      // Compressed bytes held
+  int rejected;   // Page-outs sent to disk: compressed too poorly
+  int full;       // Page-outs sent to disk: pool full
+};